@@ -10,10 +10,88 @@
  *   replacement for cache misses.
  * 
  * Compilation:
- *   gcc -std=c99 -Wall -Wextra -O2 -o cache_simulator cache_simulator.c
+ *   gcc -std=c99 -Wall -Wextra -O2 -o cache_simulator cache_simulator.c -pthread -lm
  * 
  * Usage:
- *   ./cache_simulator < trace_file
+ *   ./cache_simulator [options] < trace_file
+ *   ./cache_simulator merge [--hit-latency C] [--mem-latency C] FILE...
+ *       Combine shard partial files, or sum miss-ratio curve CSVs
+ *
+ *   Options:
+ *     --way-mask T:MASK  Restrict fills by tenant T to the ways in hex MASK
+ *     --ucp EPOCH        Utility-based partitioning, repartition every EPOCH
+ *                        accesses
+ *     --cores N          Multi-core mode: N coherent private caches
+ *     --protocol P       Coherence protocol, mesi (default) or moesi
+ *     --source F[:W]     Interleave trace file F (weight W) into one shared
+ *                        cache instead of reading stdin; repeatable
+ *     --interleave M     Interleave sources by ratio (default) or time
+ *     --threads T        With --cores: simulate private caches on T worker
+ *                        threads, synchronizing every quantum
+ *     --quantum Q        Accesses per core per quantum (default 1000)
+ *     --llc S:W          With --threads: shared LLC with S sets and W ways
+ *     --false-sharing N  With --cores: report the N worst falsely shared lines
+ *     --symbols FILE     Attribute reported lines to symbols (nm -S format)
+ *     --directory S:W[:P] With --cores: sparse directory / snoop filter with
+ *                        S sets, W ways and lru (default) or random policy
+ *     --interconnect T   With --cores: time misses over a bus, ring or mesh
+ *     --hop-latency N    Cycles per interconnect hop (default 1)
+ *     --link-bandwidth B Bytes per cycle per link (default 16)
+ *     --hit-latency N    Cache hit time in cycles (default 1)
+ *     --mem-latency N    Memory access time in cycles (default 100)
+ *     --configs FILE     Simulate every cache configuration listed in FILE
+ *                        in a single pass over the trace
+ *     --simd M           With --configs (1- and 2-way caches): simulate 8
+ *                        configurations per SIMD vector; M is auto, scalar
+ *                        (portable lane kernel) or validate
+ *     --sweep FILE       With --configs: run every (trace, config) pair for
+ *                        the trace files listed in FILE; prints CSV rows
+ *     --batch FILE       Run the trace.config cache over every trace listed
+ *                        in FILE on a thread pool; prints CSV rows
+ *     --workers N        Sweep and batch worker threads (default: online CPUs)
+ *     --numa             Pin --sweep, --batch, --set-shards and --time-chunks
+ *                        workers across NUMA nodes, keep their data local
+ *                        and report per-node throughput
+ *     --result-cache DIR Reuse --sweep and --batch results stored in DIR for
+ *                        traces with the same content and configuration
+ *     --result-cache-entries N
+ *                        Keep at most N files in DIR, evicting the least
+ *                        recently used (default 10000)
+ *     --checkpoint N:F   Save the cache state and statistics to F after N
+ *                        trace records
+ *     --restore F        Continue from checkpoint F, skipping the records
+ *                        it already covers
+ *     --warmup N         Fill the cache from the first N accesses without
+ *                        counting them in the statistics
+ *     --warmup-lines N   Warm up until N distinct lines have been touched
+ *     --shard I/N        Run only shard I of N of a --sweep or --batch job
+ *                        list; prints a partial result file for "merge"
+ *     --set-shards T     Simulate the cache on T threads, split by set index
+ *     --time-chunks T    Simulate consecutive trace chunks on T threads from
+ *                        unknown state, then reconcile them exactly
+ *     --stack-distance N LRU stack-distance pass: results for every
+ *                        associativity 1..N in one run
+ *     --all-sets         One-pass results for every power-of-two set count
+ *                        at the configured associativity
+ *     --mrc FILE         Write miss-ratio curves over every valid geometry
+ *                        as CSV, from one stack-distance pass
+ *     --target-miss P    Recommend the smallest cache with miss rate <= P%
+ *     --target-amat C    Recommend the smallest cache with AMAT <= C cycles
+ *     --reuse-distance   Fully associative LRU reuse-distance histogram
+ *     --shards-rate R    Sample lines at rate R (SHARDS) for --reuse-distance
+ *     --shards-size S    Sample at most S lines, lowering the rate as needed
+ *     --statstack R      Estimate LRU and random miss ratios from reuse
+ *                        samples taken at rate R from the trace
+ *     --reuse-samples F  Estimate from reuse times in F instead of a trace
+ *     --statstack-eval   Compare the estimates against full simulation
+ *     --set-sample N     Simulate one set in N (hashed) and estimate the
+ *                        results with 95% confidence intervals
+ *     -q, --quiet        Suppress per-access output
+ *
+ *   Trace records are Type:Size:Address[:Tenant[:Timestamp]]; the optional
+ *   tenant (or thread) id defaults to 0. Marker records M:start[:name],
+ *   M:stop and M:reset delimit regions of interest with their own
+ *   statistics.
  *   
  *   Requires trace.config file with format:
  *     Number of sets: <num>
@@ -24,16 +102,105 @@
  *   - Write-through: Writes always go to memory
  *   - No-write-allocate: Write misses don't load cache lines
  *   - LRU replacement: Evicts least recently used line on read misses
+ *   - Multi-core mode: write-back, write-allocate private caches kept
+ *     coherent by a snooping MESI/MOESI protocol
  *****************************************************************************/
 
+#define _GNU_SOURCE             // sched_setaffinity and CPU_SET
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
 
 #define MAX_CACHE_SETS 8192
 #define MAX_ASSOCIATIVITY 8
 #define MAX_LINE_SIZE 64
+#define MAX_TENANTS 16
+#define UCP_SAMPLE_STRIDE 32  // One utility-monitored set per this many sets
+#define MAX_CORES 64
+#define MAX_SOURCES MAX_TENANTS
+#define BATCH_SIZE 4096     // Decoded records per simulation batch
+#define DEFAULT_QUANTUM 1000
+#define MAX_CONFIGS 64      // Cache configurations in one --configs pass
+#define MAX_SWEEP_TRACES 65536
+#define PARTIAL_VERSION 2       // Format of --shard partial result files
+#define MAX_NUMA_NODES 8
+#define RESULT_CACHE_VERSION 1  // Bump whenever simulated results could change
+#define DEFAULT_RESULT_CACHE_ENTRIES 10000
+#define CHECKPOINT_VERSION 2
+#define MAX_ROIS 64
+#define ROI_NAME_LEN 32
+#define MAX_NUMA_CPUS 1024
+#define SIMD_LANES 8        // 32-bit lanes per AVX2 vector
+#define INVALID_TAG 0xFFFFFFFFu  // Never a tag (offset bits >= 3)
+#define SHARD_CHUNK 262144  // Records decoded per set-sharded step
+#define SHARDS_PER_THREAD 4 // Extra shards let busy sets be rebalanced
+#define TIME_CHUNK 262144   // Records per speculative chunk
+#define MAX_STACK_DEPTH 1024
+#define SET_LEVELS 14       // Set counts 1, 2, 4, ..., MAX_CACHE_SETS
+#define REUSE_BUCKETS 33    // Distance 0, then log2 buckets up to 2^32
+#define SHARDS_MODULUS (1u << 24)  // Sampling hash range
+#define SHARDS_GROUPS 8     // Independent sub-samples for the error estimate
+#define LINE_LEVELS 4       // Line sizes 8, 16, 32, 64 (validate_config limits)
+#define STATSTACK_SIZES 17  // Estimated cache sizes: 1, 2, 4, ..., 65536 lines
+#define SHARING_CORES 4     // Cores whose byte masks a sharing record keeps
+#define LINEMAP_EMPTY 0xFFFFFFFFu  // Never a line address (offset bits >= 3)
+
+// Coherence states (multi-core mode)
+#define STATE_I 0
+#define STATE_S 1
+#define STATE_E 2
+#define STATE_O 3
+#define STATE_M 4
+
+#define PROTOCOL_MESI 0
+#define PROTOCOL_MOESI 1
+
+// Miss classification (multi-core mode)
+#define MISS_NONE 0
+#define MISS_COLD 1
+#define MISS_CAPACITY 2
+#define MISS_COHERENCE 3
+#define MISS_DIRECTORY 4    // Copy lost to a directory back-invalidation
+
+#define SIMD_OFF 0
+#define SIMD_AUTO 1         // AVX2 when the CPU has it, else the scalar kernel
+#define SIMD_SCALAR 2
+#define SIMD_VALIDATE 3     // Lane engine checked against access_cache()
+
+// Requests from private caches to the directory (parallel mode)
+#define REQ_READ 0          // Read miss
+#define REQ_WRITE 1         // Write miss, needs an exclusive copy
+#define REQ_UPGRADE 2       // Write hit on a shared copy
+#define REQ_EVICT 3         // Clean line replaced
+#define REQ_WRITEBACK 4     // Dirty line replaced
+
+#define DIR_LRU 0
+#define DIR_RANDOM 1
+
+#define NET_NONE 0
+#define NET_BUS 1
+#define NET_RING 2
+#define NET_MESH 3
+
+#define CONTROL_BYTES 8     // Request, invalidation and ack message size
+#define DELAY_BUCKETS 24    // Log2 buckets of message queueing delay
 
 /**
  * Cache configuration parameters
@@ -53,6 +220,9 @@ typedef struct {
     int valid;           // Valid bit
     unsigned int tag;    // Tag bits
     unsigned int lru_counter; // For LRU replacement (higher = more recent)
+    int state;           // Coherence state (multi-core mode)
+    int owner;           // Tenant or trace source that filled the line
+    unsigned long long touched; // Bytes accessed since fill (multi-core mode)
 } CacheLine;
 
 /**
@@ -65,6 +235,593 @@ typedef struct {
     int mem_writes;
 } CacheStats;
 
+/**
+ * Whole-run statistics that may pass 2^31 accesses
+ */
+typedef struct {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long mem_reads;
+    unsigned long long mem_writes;
+} CacheTotals;
+
+/**
+ * Fixed 64-byte header of a checkpoint file (native byte order)
+ *
+ * It is followed by the run state, a Warmup and a RoiStats record, then
+ * the seen_lines line addresses of an unfinished --warmup-lines phase,
+ * then num_sets * associativity CheckpointLine records in set order.
+ */
+typedef struct {
+    char magic[8];                  // "A9CKPT" padded with zeros
+    unsigned int version;
+    unsigned int header_size;       // Offset of the first line record
+    int num_sets;
+    int associativity;
+    int line_size;
+    unsigned int seen_lines;        // Distinct lines stored for --warmup-lines
+    unsigned long long records;     // Trace records simulated before it
+    long long offset;               // Trace byte offset after them (-1 = unknown)
+    CacheStats stats;
+} CheckpointHeader;
+
+/**
+ * Set-sampled simulation: only the sets whose hash ranks in the lowest
+ * 1/ratio are simulated; per-set counts give the error estimate
+ */
+typedef struct {
+    int ratio;
+    int num_sampled;
+    unsigned char *sampled;             // Per set
+    unsigned long long *accesses;       // Per set (sampled sets only)
+    unsigned long long *misses;
+    unsigned long long *mem_reads;
+    unsigned long long total;           // Every read and write
+    unsigned long long writes;          // Exact: writes always reach memory
+    CacheStats stats;                   // Of the sampled sets
+} SetSample;
+
+/**
+ * A set index and its sampling hash
+ */
+typedef struct {
+    unsigned int hash;
+    int set;
+} SetRank;
+
+/**
+ * Warmup phase: accesses fill the cache but are counted separately
+ */
+typedef struct {
+    unsigned long long max_accesses;    // Warm for this many accesses (0 = off)
+    unsigned long long max_lines;       // ... or until this many distinct lines
+    int active;
+    CacheStats stats;                   // Accesses excluded from the results
+} Warmup;
+
+/**
+ * Statistics of the regions of interest delimited by trace markers
+ */
+typedef struct {
+    int num_regions;
+    char names[MAX_ROIS][ROI_NAME_LEN];
+    CacheStats stats[MAX_ROIS];
+    int open;                           // Region being recorded (-1 = none)
+} RoiStats;
+
+/**
+ * Compact on-disk cache line: tag, valid bit and LRU rank
+ */
+typedef struct {
+    unsigned int tag;
+    unsigned char valid;
+    unsigned char lru;              // LRU counter (< MAX_ASSOCIATIVITY)
+    unsigned char owner;
+    unsigned char state;
+} CheckpointLine;
+
+/**
+ * Per-tenant results for one way allocation (one UCP epoch)
+ */
+typedef struct {
+    int ways[MAX_TENANTS];            // Ways allocated to each tenant
+    CacheStats stats[MAX_TENANTS];    // Tenant statistics under allocation
+} PartitionEpoch;
+
+/**
+ * Way-partitioning state (static CAT-style masks or UCP)
+ */
+typedef struct {
+    int enabled;
+    int num_tenants;                  // Highest tenant id seen + 1
+    unsigned int way_mask[MAX_TENANTS]; // Ways each tenant may fill
+    CacheStats tenant_stats[MAX_TENANTS];
+    CacheStats epoch_stats[MAX_TENANTS];
+
+    // Utility monitors: sampled shadow tags, tenant-private full-cache LRU
+    int ucp_epoch;                    // Accesses per epoch (0 = static masks)
+    int epoch_accesses;
+    int num_sampled;                  // Sampled sets per tenant
+    unsigned int *shadow_tags;        // [tenant][sampled set][way], MRU first
+    unsigned int *umon_hits;          // [tenant][way] hits per stack position
+
+    PartitionEpoch *history;          // Completed allocations, in order
+    int num_epochs;
+    int history_capacity;
+} PartitionState;
+
+/**
+ * Command-line options other than partitioning
+ */
+typedef struct {
+    int quiet;              // Suppress per-access output
+    int num_cores;          // Private caches in multi-core mode (0 = off)
+    int protocol;           // PROTOCOL_MESI or PROTOCOL_MOESI
+    int num_sources;        // Interleaved trace files (0 = read stdin)
+    const char *source_path[MAX_SOURCES];
+    int source_weight[MAX_SOURCES];
+    int by_timestamp;       // Interleave by record timestamp, not ratio
+    int num_threads;        // Parallel multi-core workers (0 = sequential)
+    int quantum;            // Accesses per core per quantum
+    int llc_sets;           // Shared LLC geometry (0 = no LLC)
+    int llc_ways;
+    int false_sharing_top;  // False-sharing lines to report (0 = off)
+    const char *symbol_path;
+    int dir_sets;           // Sparse directory geometry (0 = full map)
+    int dir_ways;
+    int dir_policy;         // DIR_LRU or DIR_RANDOM
+    int topology;           // NET_* interconnect (NET_NONE = untimed)
+    int hop_latency;
+    int link_bandwidth;
+    int hit_latency;
+    int mem_latency;
+    const char *configs_path;  // Multi-config list (NULL = trace.config)
+    const char *sweep_path;    // Trace list of a pooled sweep
+    int simd;                  // SIMD_* lane engine for --configs
+    int num_workers;
+    const char *batch_path;    // Trace manifest of a batch run
+    int numa;                  // NUMA-aware worker placement
+    const char *checkpoint_path;   // Save state here (NULL = no checkpoint)
+    unsigned long long checkpoint_at;  // ... after this many records
+    const char *restore_path;      // Start from this checkpoint
+    unsigned long long warmup_accesses;  // Uncounted leading accesses (0 = none)
+    unsigned long long warmup_lines;     // ... or distinct lines (0 = none)
+    const char *result_cache_dir;  // On-disk result cache (NULL = off)
+    int result_cache_entries;
+    int shard_index;           // --shard I/N (shard_count 0 = all jobs)
+    int shard_count;
+    int set_shards;         // Set-sharded threads (0 = sequential)
+    int time_chunks;        // Chunk-parallel threads (0 = sequential)
+    int stack_depth;        // Stack-distance associativity limit (0 = off)
+    int all_sets;           // One-pass sweep of every set count
+    int reuse_distance;     // Reuse-distance profile (fully associative)
+    double shards_rate;     // Fixed sampling rate (0 = no fixed rate)
+    int shards_size;        // Fixed sample size in lines (0 = no bound)
+    const char *mrc_path;   // Miss-ratio curve CSV (NULL = none)
+    double target_miss;     // Sizing query: miss rate in percent (0 = none)
+    double target_amat;     // Sizing query: cycles (0 = none)
+    double statstack_rate;  // Reuse sampling rate (0 = off)
+    const char *reuse_samples_path;
+    int statstack_eval;     // Also simulate for comparison
+    int set_sample;         // Simulate one set in N (0 = all sets)
+} SimOptions;
+
+/**
+ * Decoded trace record
+ */
+typedef struct {
+    char type;
+    unsigned char size;
+    unsigned char source;   // Tenant, thread or trace source id
+    unsigned int address;
+    unsigned long long timestamp;
+} TraceRecord;
+
+/**
+ * One trace file feeding the shared cache
+ */
+typedef struct {
+    FILE *fp;
+    int weight;             // Records taken per interleaving round
+    int eof;
+    TraceRecord head;       // Next record (timestamp interleaving)
+    int has_head;
+} TraceSource;
+
+/**
+ * Shared cache fed by several interleaved traces
+ */
+typedef struct {
+    int num_sources;
+    int by_timestamp;
+    int active;             // Sources not yet exhausted
+    int cur_source;         // Ratio interleaving position
+    int cur_taken;
+    TraceSource sources[MAX_SOURCES];
+    CacheStats source_stats[MAX_SOURCES];
+    int stolen[MAX_SOURCES][MAX_SOURCES];  // [victim source][evicting source]
+} SharedCache;
+
+/**
+ * Cache configurations simulated together in one pass over the trace
+ *
+ * Every configuration's lines live in one arena, laid out config by config,
+ * so a configuration's sets are contiguous while a batch is replayed on it.
+ */
+typedef struct {
+    int num_configs;
+    CacheConfig configs[MAX_CONFIGS];
+    CacheLine **caches[MAX_CONFIGS];
+    CacheStats stats[MAX_CONFIGS];
+    FILE *output[MAX_CONFIGS];        // Per-access output (NULL = none)
+    CacheLine *arena;
+    CacheLine **set_table;            // Set pointers of every configuration
+} ConfigSweep;
+
+/**
+ * Up to SIMD_LANES direct-mapped or 2-way caches, one per vector lane
+ *
+ * State is interleaved by lane: entry [set * SIMD_LANES + lane] of each
+ * array belongs to that lane's cache, so one gather per array fetches the
+ * set each lane's cache maps the same address to. A 2-way set keeps one
+ * LRU bit naming the way to fill next; invalid ways hold INVALID_TAG.
+ */
+typedef struct {
+    int num_lanes;
+    int config_index[SIMD_LANES];        // Configuration of each lane
+    int offset_shift[SIMD_LANES];
+    int tag_shift[SIMD_LANES];
+    int index_mask[SIMD_LANES];
+    int two_way[SIMD_LANES];             // All ones for 2-way lanes
+    unsigned int *tags0;
+    unsigned int *tags1;
+    unsigned int *lru;
+    int hits[SIMD_LANES];
+    int misses[SIMD_LANES];
+    int read_misses[SIMD_LANES];
+    int writes;
+} LaneGroup;
+
+/**
+ * Decoded trace shared read-only by sweep jobs
+ */
+typedef struct {
+    char *path;
+    TraceRecord *records;
+    int count;
+    int node;                                   // Node that decoded it
+    unsigned long long hash;                    // Content hash (result cache)
+    int has_hash;
+    long long stamp[4];                         // Size, inode, mtime, ctime
+    int stamped;
+    TraceRecord *replicas[MAX_NUMA_NODES];      // Copies local to other nodes
+} TraceBuffer;
+
+/**
+ * Placement of pool workers on NUMA nodes, and the accesses each simulated
+ */
+typedef struct {
+    int num_nodes;
+    int node_id[MAX_NUMA_NODES];    // sysfs node number of each node
+    int num_workers;
+    int *cpu;                       // Per worker: CPU it is pinned to
+    int *node;                      // Per worker: index into node_id
+    unsigned long long *accesses;   // Per worker
+    int replicate;                  // Copy shared traces to every node
+    pthread_mutex_t replica_lock[MAX_NUMA_NODES];
+} NumaTopology;
+
+/**
+ * Job queue of one pool worker; the owner pops from the bottom and idle
+ * workers steal from the top
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    int *jobs;
+    int top;
+    int bottom;
+    int executed;           // Jobs this worker ran
+    int stolen;             // Of those, jobs taken from other workers
+} JobDeque;
+
+/**
+ * Work-stealing pool running a fixed set of independent jobs
+ */
+typedef struct {
+    int num_workers;
+    JobDeque *deques;
+    void (*run_job)(void *ctx, int job, int worker);
+    void *ctx;
+    NumaTopology *numa;     // Pin workers (NULL = unpinned)
+} JobPool;
+
+/**
+ * Pool worker argument
+ */
+typedef struct {
+    JobPool *pool;
+    int worker;
+} PoolArg;
+
+/**
+ * On-disk store of simulation results keyed by trace content and geometry
+ *
+ * Each entry is one small file, written to a temporary name and renamed,
+ * so concurrent --shard processes can share a directory. A file's mtime is
+ * its last use, which drives LRU eviction.
+ */
+typedef struct {
+    const char *dir;
+    int max_entries;
+    int hits;               // Jobs answered from the store
+    int misses;
+} ResultCache;
+
+/**
+ * Every (trace, configuration) pair of a pooled sweep
+ */
+typedef struct {
+    ConfigSweep *configs;
+    int num_traces;
+    TraceBuffer traces[MAX_SWEEP_TRACES];
+    CacheStats *results;    // [trace * num_configs + config]
+    NumaTopology *numa;     // NULL = no placement
+    ResultCache *result_cache;  // NULL = simulate everything
+} SweepJobs;
+
+/**
+ * One configuration over many traces; each worker reuses one cache
+ */
+typedef struct {
+    CacheConfig *config;
+    SweepJobs jobs;             // Trace paths and per-trace results
+    CacheLine ***caches;        // Per worker
+    unsigned char *failed;      // Per trace: could not be opened
+} BatchRun;
+
+/**
+ * One chunk of a set-sharded run: records grouped by the shard owning
+ * their set, with results kept in trace order
+ */
+typedef struct {
+    CacheLine **cache;
+    CacheConfig *config;
+    int num_shards;             // Power of two; shard = set index % num_shards
+    TraceRecord *records;       // Chunk in trace order
+    int *order;                 // Record positions grouped by shard
+    int shard_start[MAX_CACHE_SETS + 1];
+    signed char *results;       // Per record: 1 hit, 0 miss, -1 skipped
+    CacheStats *shard_stats;    // Per shard, this chunk
+    CacheTotals *shard_totals;  // Per shard, whole run
+    NumaTopology *numa;         // NULL = no placement
+} ShardedRun;
+
+/**
+ * Open-addressing hash map from line address to a 32-bit value
+ */
+typedef struct {
+    unsigned int *keys;     // LINEMAP_EMPTY marks a free slot
+    unsigned int *values;
+    unsigned int capacity;  // Power of 2
+    unsigned int count;
+} LineMap;
+
+/**
+ * Per-core statistics with miss classification
+ */
+typedef struct {
+    CacheStats stats;
+    int cold_misses;
+    int capacity_misses;    // Capacity and conflict misses
+    int coherence_misses;
+    int directory_misses;   // Copy lost to a directory eviction
+} CoreStats;
+
+/**
+ * Coherence traffic counters
+ */
+typedef struct {
+    int invalidations;      // Remote copies invalidated
+    int upgrades;           // Write hits on shared lines
+    int c2c_transfers;      // Misses supplied by another cache
+    int writebacks;         // Dirty lines written to memory
+} CoherenceStats;
+
+/**
+ * Write invalidations of one line, for false-sharing detection
+ */
+typedef struct {
+    unsigned int line_addr;
+    int invalidations;           // Remote copies invalidated by writes
+    int false_invalidations;     // ... whose used bytes the write missed
+    int num_cores;               // Cores recorded in core_ids
+    int core_ids[SHARING_CORES];
+    unsigned long long core_bytes[SHARING_CORES];  // Bytes each core used
+} SharingLine;
+
+/**
+ * Per-line invalidation records
+ */
+typedef struct {
+    LineMap index;               // Line address -> record number
+    SharingLine *lines;
+    int count;
+    int capacity;
+    int invalidations;
+    int false_invalidations;
+} FalseSharing;
+
+/**
+ * Symbol from an address-to-symbol map
+ */
+typedef struct {
+    unsigned long long start;
+    unsigned long long size;
+    char name[64];
+} Symbol;
+
+/**
+ * Address-to-symbol map, sorted by start address
+ */
+typedef struct {
+    Symbol *symbols;
+    int count;
+} SymbolMap;
+
+/**
+ * Directory entry: which cores hold a line
+ */
+typedef struct {
+    unsigned long long sharers;  // Bit per core
+    int owner;              // Core holding the line E, M or O, or -1
+    unsigned int line_addr; // Sparse mode: tracked line
+    int valid;              // Sparse mode: entry in use
+    unsigned int lru;       // Sparse mode: last use (higher = more recent)
+} DirEntry;
+
+/**
+ * Directory statistics
+ */
+typedef struct {
+    int lookups;
+    int hits;
+    int allocations;
+    int evictions;          // Valid entries replaced (sparse mode)
+    int back_invalidations; // Private copies invalidated by evictions
+} DirectoryStats;
+
+/**
+ * Coherence directory: a full map, or a sparse set-associative directory
+ * (snoop filter) whose evictions invalidate the private copies it tracked
+ */
+typedef struct {
+    int sparse;
+    DirEntry *entries;      // Full map: grows; sparse: [set][way]
+    int count;
+    int capacity;
+    LineMap index;          // Full map: line address -> entry number
+    int sets;               // Sparse geometry
+    int ways;
+    int policy;             // DIR_LRU or DIR_RANDOM
+    unsigned int clock;     // LRU timestamp source
+    unsigned int rng;       // Random replacement state (fixed seed)
+    DirectoryStats stats;
+} Directory;
+
+/**
+ * Busy intervals of one link, sorted and disjoint; [start, end) cycles
+ */
+typedef struct {
+    unsigned long long *start;
+    unsigned long long *end;
+    int first;              // Intervals before first are dropped
+    int count;
+    int capacity;
+} LinkSchedule;
+
+/**
+ * Interconnect carrying miss, writeback and coherence messages between the
+ * cores and the memory controller (the last node)
+ */
+typedef struct {
+    int topology;           // NET_BUS, NET_RING or NET_MESH
+    int num_nodes;
+    int mesh_cols;
+    int hop_latency;
+    int bandwidth;          // Bytes per cycle per link
+    int num_links;
+    LinkSchedule *schedule;           // [link] reserved cycles
+    unsigned long long horizon;       // No message is injected earlier
+    unsigned long long *busy_cycles;  // [link]
+    unsigned long long *link_delay;   // [link] total queueing delay
+    int *link_messages;               // [link]
+    unsigned long long messages;
+    unsigned long long queue_cycles;
+    unsigned long long delay_hist[DELAY_BUCKETS];
+} Interconnect;
+
+/**
+ * Multi-core system: one private cache per core, kept coherent by snooping
+ */
+typedef struct {
+    CacheConfig *config;
+    int num_cores;
+    int protocol;
+    CacheLine ***caches;    // [core][set][way]
+    LineMap *history;       // Per core: lines held before (1), lost to an
+                            // invalidation (2) or to a directory eviction (3)
+    CoreStats *core_stats;
+    CoherenceStats coherence;
+    FalseSharing *sharing;  // False-sharing detector (NULL = off)
+    Directory *filter;      // Snoop filter (NULL = broadcast snooping)
+    Interconnect *net;      // Timing model (NULL = untimed)
+    unsigned long long *cycles;  // [core] local clock (timed mode)
+    unsigned long long *first_cycle;  // [core] clock at its first access,
+                                      // ~0 before it (timed mode)
+    int hit_latency;
+    int mem_latency;
+} MultiCore;
+
+/**
+ * Private-cache request waiting for the directory
+ */
+typedef struct {
+    unsigned int line_addr;
+    int type;               // REQ_* code
+    unsigned int time;      // Core-local access number
+    unsigned long long bytes;  // Bytes written (REQ_WRITE, REQ_UPGRADE)
+} CoherenceRequest;
+
+/**
+ * Lock-free single-producer, single-consumer request queue
+ */
+typedef struct {
+    CoherenceRequest *slots;
+    unsigned int mask;      // Capacity - 1 (capacity is a power of 2)
+    unsigned int head;      // Next slot to consume
+    unsigned int tail;      // Next slot to produce
+} RequestQueue;
+
+/**
+ * Per-core decoded trace
+ */
+typedef struct {
+    TraceRecord *records;
+    int count;
+    int capacity;
+} CoreTrace;
+
+/**
+ * Quantum-synchronized parallel multi-core simulation
+ */
+typedef struct {
+    MultiCore *mc;
+    int num_threads;
+    int quantum;
+    int current_quantum;
+    int done;               // Tells workers to exit
+    CoreTrace *traces;      // [core]
+    RequestQueue *queues;   // [core]
+    Directory dir;
+    int dir_sets;           // Sparse directory geometry (0 = full map)
+    int dir_ways;
+    int dir_policy;
+    int has_llc;
+    CacheConfig llc_config;
+    CacheLine **llc;
+    CacheStats llc_stats;
+    pthread_barrier_t start_barrier;
+    pthread_barrier_t finish_barrier;
+} ParallelSim;
+
+/**
+ * Worker thread argument
+ */
+typedef struct {
+    ParallelSim *sim;
+    int worker;
+} WorkerArg;
+
 /**
  * Calculate log base 2 of a number
  */
@@ -77,6 +834,116 @@ int log2_int(int n) {
     return bits;
 }
 
+/**
+ * Initialize an empty line map
+ */
+void linemap_init(LineMap *map, unsigned int capacity) {
+    map->capacity = 16;
+    while (map->capacity < capacity) {
+        map->capacity <<= 1;
+    }
+    map->count = 0;
+    map->keys = (unsigned int *)malloc(map->capacity * sizeof(unsigned int));
+    map->values = (unsigned int *)malloc(map->capacity * sizeof(unsigned int));
+    if (map->keys == NULL || map->values == NULL) {
+        fprintf(stderr, "Error: Failed to allocate line map\n");
+        exit(1);
+    }
+    memset(map->keys, 0xFF, map->capacity * sizeof(unsigned int));
+}
+
+/**
+ * Hash a line address to a slot (Fibonacci hashing)
+ */
+unsigned int linemap_slot(LineMap *map, unsigned int key) {
+    return (key * 2654435769u) & (map->capacity - 1);
+}
+
+/**
+ * Find the value stored for a line, or NULL if absent
+ */
+unsigned int *linemap_find(LineMap *map, unsigned int key) {
+    unsigned int slot = linemap_slot(map, key);
+    
+    while (map->keys[slot] != LINEMAP_EMPTY) {
+        if (map->keys[slot] == key) {
+            return &map->values[slot];
+        }
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+    
+    return NULL;
+}
+
+/**
+ * Find the value stored for a line, inserting it with value 0 if absent
+ */
+unsigned int *linemap_insert(LineMap *map, unsigned int key) {
+    // Grow at 50% load to keep probe sequences short
+    if (2 * (map->count + 1) > map->capacity) {
+        LineMap grown;
+        linemap_init(&grown, 2 * map->capacity);
+        for (unsigned int i = 0; i < map->capacity; i++) {
+            if (map->keys[i] != LINEMAP_EMPTY) {
+                *linemap_insert(&grown, map->keys[i]) = map->values[i];
+            }
+        }
+        free(map->keys);
+        free(map->values);
+        *map = grown;
+    }
+    
+    unsigned int slot = linemap_slot(map, key);
+    while (map->keys[slot] != LINEMAP_EMPTY) {
+        if (map->keys[slot] == key) {
+            return &map->values[slot];
+        }
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+    
+    map->keys[slot] = key;
+    map->values[slot] = 0;
+    map->count++;
+    return &map->values[slot];
+}
+
+/**
+ * Remove a line if present, shifting later entries of its probe run back
+ */
+void linemap_remove(LineMap *map, unsigned int key) {
+    unsigned int mask = map->capacity - 1;
+    unsigned int hole = linemap_slot(map, key);
+    
+    while (map->keys[hole] != key) {
+        if (map->keys[hole] == LINEMAP_EMPTY) {
+            return;
+        }
+        hole = (hole + 1) & mask;
+    }
+    
+    for (unsigned int next = (hole + 1) & mask; map->keys[next] != LINEMAP_EMPTY;
+         next = (next + 1) & mask) {
+        unsigned int home = linemap_slot(map, map->keys[next]);
+        // Move the entry back unless its home lies in (hole, next]
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map->keys[hole] = map->keys[next];
+            map->values[hole] = map->values[next];
+            hole = next;
+        }
+    }
+    
+    map->keys[hole] = LINEMAP_EMPTY;
+    map->count--;
+}
+
+/**
+ * Free line map memory
+ */
+void linemap_free(LineMap *map) {
+    free(map->keys);
+    free(map->values);
+}
+
 /**
  * Initialize cache structure and configuration
  */
@@ -104,6 +971,9 @@ void init_cache(CacheLine ***cache, CacheConfig *config) {
             (*cache)[i][j].valid = 0;
             (*cache)[i][j].tag = 0;
             (*cache)[i][j].lru_counter = 0;
+            (*cache)[i][j].state = STATE_I;
+            (*cache)[i][j].owner = 0;
+            (*cache)[i][j].touched = 0;
         }
     }
 }
@@ -126,22 +996,23 @@ void update_lru(CacheLine *set, int associativity, int accessed_way) {
 }
 
 /**
- * Find LRU victim for replacement
+ * Find LRU victim for replacement among the ways allowed by way_mask
  */
-int find_lru_victim(CacheLine *set, int associativity) {
-    int lru_way = 0;
-    unsigned int min_counter = set[0].lru_counter;
+int find_lru_victim(CacheLine *set, int associativity, unsigned int way_mask) {
+    int lru_way = -1;
+    unsigned int min_counter = 0;
     
     // Find invalid line first (cold miss)
     for (int i = 0; i < associativity; i++) {
-        if (!set[i].valid) {
+        if ((way_mask & (1u << i)) && !set[i].valid) {
             return i;
         }
     }
     
     // Find LRU line
-    for (int i = 1; i < associativity; i++) {
-        if (set[i].lru_counter < min_counter) {
+    for (int i = 0; i < associativity; i++) {
+        if ((way_mask & (1u << i)) &&
+            (lru_way < 0 || set[i].lru_counter < min_counter)) {
             min_counter = set[i].lru_counter;
             lru_way = i;
         }
@@ -151,22 +1022,221 @@ int find_lru_victim(CacheLine *set, int associativity) {
 }
 
 /**
- * Simulate a cache access
+ * Find the way holding tag in a set, or -1
+ */
+int find_way(CacheLine *set, int associativity, unsigned int tag) {
+    for (int i = 0; i < associativity; i++) {
+        if (set[i].valid && set[i].tag == tag) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Initialize way-partitioning state; unmasked tenants may use every way
  */
-void access_cache(CacheLine **cache, CacheConfig *config, char access_type,
-                  unsigned int address, CacheStats *stats) {
+void init_partition(PartitionState *ps, CacheConfig *config) {
+    unsigned int all_ways = (1u << config->associativity) - 1;
     
-    // Extract address components
-    unsigned int offset = address & ((1 << config->offset_bits) - 1);
+    for (int t = 0; t < MAX_TENANTS; t++) {
+        if (ps->way_mask[t] == 0) {
+            ps->way_mask[t] = all_ways;
+        }
+    }
+    
+    if (ps->ucp_epoch > 0) {
+        // Tenants share every way until the first epoch completes
+        for (int t = 0; t < MAX_TENANTS; t++) {
+            ps->way_mask[t] = all_ways;
+        }
+        
+        ps->num_sampled = (config->num_sets + UCP_SAMPLE_STRIDE - 1) / UCP_SAMPLE_STRIDE;
+        ps->shadow_tags = (unsigned int *)calloc((size_t)MAX_TENANTS * ps->num_sampled *
+                                                 config->associativity, sizeof(unsigned int));
+        ps->umon_hits = (unsigned int *)calloc((size_t)MAX_TENANTS * config->associativity,
+                                               sizeof(unsigned int));
+        if (ps->shadow_tags == NULL || ps->umon_hits == NULL) {
+            fprintf(stderr, "Error: Failed to allocate utility monitors\n");
+            exit(1);
+        }
+    }
+}
+
+/**
+ * Update a tenant's utility monitor with an access to a sampled set
+ *
+ * Each monitor is an LRU stack as deep as the cache, so a hit at stack
+ * position p would have hit had the tenant owned p + 1 ways.
+ */
+void umon_access(PartitionState *ps, CacheConfig *config, int tenant,
+                 unsigned int address, int is_read) {
     unsigned int index = (address >> config->offset_bits) & ((1 << config->index_bits) - 1);
     unsigned int tag = address >> (config->offset_bits + config->index_bits);
     
-    // Search for tag in the set
-    int hit = 0;
-    int hit_way = -1;
+    if (index % UCP_SAMPLE_STRIDE != 0) {
+        return;
+    }
     
-    for (int i = 0; i < config->associativity; i++) {
-        if (cache[index][i].valid && cache[index][i].tag == tag) {
+    int assoc = config->associativity;
+    unsigned int *stack = ps->shadow_tags +
+        ((size_t)tenant * ps->num_sampled + index / UCP_SAMPLE_STRIDE) * assoc;
+    unsigned int key = tag + 1;  // 0 marks an empty shadow way
+    int pos = -1;
+    
+    for (int i = 0; i < assoc; i++) {
+        if (stack[i] == key) {
+            pos = i;
+            break;
+        }
+    }
+    
+    if (pos >= 0) {
+        ps->umon_hits[tenant * assoc + pos]++;
+    } else if (is_read) {
+        pos = assoc - 1;
+    } else {
+        return;  // No-write-allocate: write misses leave the stack alone
+    }
+    
+    // Move to MRU position
+    for (int i = pos; i > 0; i--) {
+        stack[i] = stack[i - 1];
+    }
+    stack[0] = key;
+}
+
+/**
+ * Record the finished allocation and its per-tenant statistics
+ */
+void close_partition_epoch(PartitionState *ps, CacheConfig *config) {
+    if (ps->num_epochs == ps->history_capacity) {
+        ps->history_capacity = ps->history_capacity ? 2 * ps->history_capacity : 16;
+        ps->history = (PartitionEpoch *)realloc(ps->history,
+                                                ps->history_capacity * sizeof(PartitionEpoch));
+        if (ps->history == NULL) {
+            fprintf(stderr, "Error: Failed to allocate partition history\n");
+            exit(1);
+        }
+    }
+    
+    PartitionEpoch *epoch = &ps->history[ps->num_epochs++];
+    for (int t = 0; t < MAX_TENANTS; t++) {
+        epoch->ways[t] = 0;
+        for (int i = 0; i < config->associativity; i++) {
+            if (ps->way_mask[t] & (1u << i)) {
+                epoch->ways[t]++;
+            }
+        }
+        epoch->stats[t] = ps->epoch_stats[t];
+    }
+    memset(ps->epoch_stats, 0, sizeof(ps->epoch_stats));
+}
+
+/**
+ * Recompute UCP way allocation with the lookahead algorithm
+ *
+ * Every tenant keeps at least one way; remaining ways go repeatedly to the
+ * tenant with the highest marginal utility (extra hits per extra way).
+ * Monitor counters are halved afterwards so older epochs decay.
+ */
+void ucp_repartition(PartitionState *ps, CacheConfig *config) {
+    int assoc = config->associativity;
+    int tenants = ps->num_tenants;
+    int alloc[MAX_TENANTS];
+    int balance = assoc - tenants;
+    
+    close_partition_epoch(ps, config);
+    
+    for (int t = 0; t < tenants; t++) {
+        alloc[t] = 1;
+    }
+    
+    while (balance > 0) {
+        int best_tenant = 0;
+        int best_ways = 1;
+        double best_mu = -1.0;
+        
+        for (int t = 0; t < tenants; t++) {
+            unsigned int gain = 0;
+            for (int k = 1; k <= balance; k++) {
+                gain += ps->umon_hits[t * assoc + alloc[t] + k - 1];
+                double mu = (double)gain / k;
+                if (mu > best_mu) {
+                    best_mu = mu;
+                    best_tenant = t;
+                    best_ways = k;
+                }
+            }
+        }
+        
+        alloc[best_tenant] += best_ways;
+        balance -= best_ways;
+    }
+    
+    // Lay allocations out as contiguous way masks
+    int next_way = 0;
+    for (int t = 0; t < tenants; t++) {
+        ps->way_mask[t] = ((1u << alloc[t]) - 1) << next_way;
+        next_way += alloc[t];
+    }
+    
+    for (int i = 0; i < MAX_TENANTS * assoc; i++) {
+        ps->umon_hits[i] >>= 1;
+    }
+}
+
+/**
+ * Free way-partitioning state
+ */
+void free_partition(PartitionState *ps) {
+    free(ps->shadow_tags);
+    free(ps->umon_hits);
+    free(ps->history);
+}
+
+/**
+ * Count one access in a statistics block
+ */
+void record_access(CacheStats *stats, char access_type, int hit) {
+    if (hit) {
+        stats->hits++;
+    } else {
+        stats->misses++;
+    }
+    
+    if (access_type == 'W' || access_type == 'w') {
+        stats->mem_writes++;
+    } else if (!hit) {
+        stats->mem_reads++;
+    }
+}
+
+/**
+ * Simulate a cache access; read misses fill only ways in way_mask
+ *
+ * The filled line is tagged with owner. When a valid line is evicted its
+ * owner is stored in *evicted_owner (if not NULL), otherwise -1.
+ * Returns 1 on a hit, 0 on a miss and -1 for an unknown access type.
+ */
+int access_cache(CacheLine **cache, CacheConfig *config, char access_type,
+                 unsigned int address, unsigned int way_mask, int owner,
+                 int *evicted_owner, CacheStats *stats) {
+    
+    // Extract address components
+    unsigned int index = (address >> config->offset_bits) & ((1 << config->index_bits) - 1);
+    unsigned int tag = address >> (config->offset_bits + config->index_bits);
+    
+    // Search for tag in the set
+    int hit = 0;
+    int hit_way = -1;
+    
+    if (evicted_owner != NULL) {
+        *evicted_owner = -1;
+    }
+    
+    for (int i = 0; i < config->associativity; i++) {
+        if (cache[index][i].valid && cache[index][i].tag == tag) {
             hit = 1;
             hit_way = i;
             break;
@@ -183,82 +1253,5920 @@ void access_cache(CacheLine **cache, CacheConfig *config, char access_type,
             stats->mem_reads++;
             
             // Find victim and replace
-            int victim_way = find_lru_victim(cache[index], config->associativity);
+            int victim_way = find_lru_victim(cache[index], config->associativity, way_mask);
+            if (evicted_owner != NULL && cache[index][victim_way].valid) {
+                *evicted_owner = cache[index][victim_way].owner;
+            }
             cache[index][victim_way].valid = 1;
             cache[index][victim_way].tag = tag;
+            cache[index][victim_way].owner = owner;
             update_lru(cache[index], config->associativity, victim_way);
         }
-        
-        printf("%c %08x %x %x %x %s %d\n",
-               access_type, address, tag, index, offset,
-               hit ? "hit " : "miss", hit ? 0 : 1);
     }
-    // Handle write access (write-through, no-write-allocate)
-    else if (access_type == 'W' || access_type == 'w') {
-        stats->mem_writes++;
-        
-        if (hit) {
-            stats->hits++;
-            update_lru(cache[index], config->associativity, hit_way);
-        } else {
-            stats->misses++;
-            // No write allocate - don't load into cache
+    // Handle write access (write-through, no-write-allocate)
+    else if (access_type == 'W' || access_type == 'w') {
+        stats->mem_writes++;
+        
+        if (hit) {
+            stats->hits++;
+            update_lru(cache[index], config->associativity, hit_way);
+        } else {
+            stats->misses++;
+            // No write allocate - don't load into cache
+        }
+    }
+    else {
+        return -1;
+    }
+    
+    return hit;
+}
+
+/**
+ * Print the per-access output line
+ */
+void print_access(FILE *out, CacheConfig *config, char access_type,
+                  unsigned int address, int hit) {
+    unsigned int offset = address & ((1 << config->offset_bits) - 1);
+    unsigned int index = (address >> config->offset_bits) & ((1 << config->index_bits) - 1);
+    unsigned int tag = address >> (config->offset_bits + config->index_bits);
+    int is_write = access_type == 'W' || access_type == 'w';
+    
+    fprintf(out, "%c %08x %x %x %x %s %d\n",
+           access_type, address, tag, index, offset,
+           hit ? "hit " : "miss", (is_write || !hit) ? 1 : 0); // Always 1 mem ref for writes
+}
+
+/**
+ * Free cache memory
+ */
+void free_cache(CacheLine **cache, int num_sets) {
+    for (int i = 0; i < num_sets; i++) {
+        free(cache[i]);
+    }
+    free(cache);
+}
+
+/**
+ * Empty every set of a cache
+ */
+void reset_cache(CacheLine **cache, CacheConfig *config) {
+    for (int i = 0; i < config->num_sets; i++) {
+        memset(cache[i], 0, config->associativity * sizeof(CacheLine));
+    }
+}
+
+/**
+ * Parse and validate one trace line; returns 1 for a usable record
+ */
+int parse_record(const char *line, TraceRecord *rec) {
+    int size;
+    int tenant = 0;
+    
+    rec->timestamp = 0;
+    if (sscanf(line, "%c:%d:%x:%d:%llu", &rec->type, &size, &rec->address,
+               &tenant, &rec->timestamp) < 3) {
+        return 0; // Skip malformed lines
+    }
+    
+    // Validate tenant or thread id; each mode checks its own, tighter limit
+    if (tenant < 0 || tenant >= MAX_CORES) {
+        fprintf(stderr, "Warning: Invalid tenant %d, skipping\n", tenant);
+        return 0;
+    }
+    
+    // Validate access size
+    if (size != 1 && size != 2 && size != 4 && size != 8) {
+        fprintf(stderr, "Warning: Invalid access size %d, skipping\n", size);
+        return 0;
+    }
+    
+    // Check alignment
+    if ((rec->address & (size - 1)) != 0) {
+        fprintf(stderr, "Warning: Misaligned access at 0x%x, skipping\n", rec->address);
+        return 0;
+    }
+    
+    rec->size = (unsigned char)size;
+    rec->source = (unsigned char)tenant;
+    return 1;
+}
+
+/**
+ * FNV-1a hash of a byte range, continuing from h
+ */
+unsigned long long fnv1a(unsigned long long h, const unsigned char *data, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ data[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/**
+ * Read the next usable record from a trace file; returns 0 at end of file
+ *
+ * With hash != NULL every byte read, skipped lines included, is folded into
+ * *hash, so a trace read to the end yields the FNV-1a hash of its content.
+ */
+int read_record_hashed(FILE *fp, TraceRecord *rec, unsigned long long *hash) {
+    char line[256];
+    
+    while (fgets(line, sizeof(line), fp)) {
+        if (hash != NULL) {
+            *hash = fnv1a(*hash, (const unsigned char *)line, strlen(line));
+        }
+        if (parse_record(line, rec)) {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Read the next usable record from a trace file; returns 0 at end of file
+ */
+int read_record(FILE *fp, TraceRecord *rec) {
+    return read_record_hashed(fp, rec, NULL);
+}
+
+/**
+ * Open the trace files of an interleaved shared-cache run
+ */
+void init_shared(SharedCache *sc, SimOptions *opts) {
+    memset(sc, 0, sizeof(*sc));
+    sc->num_sources = opts->num_sources;
+    sc->by_timestamp = opts->by_timestamp;
+    sc->active = opts->num_sources;
+    
+    for (int s = 0; s < sc->num_sources; s++) {
+        TraceSource *src = &sc->sources[s];
+        src->fp = fopen(opts->source_path[s], "r");
+        if (src->fp == NULL) {
+            fprintf(stderr, "Error: Cannot open trace %s\n", opts->source_path[s]);
+            exit(1);
+        }
+        src->weight = opts->source_weight[s];
+        
+        if (sc->by_timestamp) {
+            src->has_head = read_record(src->fp, &src->head);
+            src->head.source = (unsigned char)s;
+        }
+    }
+}
+
+/**
+ * Fill a batch by taking each source's weight in records per round
+ *
+ * Returns the number of records; 0 once every source is exhausted.
+ */
+int fill_batch_ratio(SharedCache *sc, TraceRecord *batch) {
+    int n = 0;
+    
+    while (n < BATCH_SIZE && sc->active > 0) {
+        TraceSource *src = &sc->sources[sc->cur_source];
+        
+        if (!src->eof && sc->cur_taken < src->weight) {
+            if (read_record(src->fp, &batch[n])) {
+                batch[n++].source = (unsigned char)sc->cur_source;
+                sc->cur_taken++;
+                continue;
+            }
+            src->eof = 1;
+            sc->active--;
+        }
+        
+        sc->cur_source = (sc->cur_source + 1) % sc->num_sources;
+        sc->cur_taken = 0;
+    }
+    
+    return n;
+}
+
+/**
+ * Fill a batch by merging sources in timestamp order (ties go to the
+ * lower source number)
+ */
+int fill_batch_timestamp(SharedCache *sc, TraceRecord *batch) {
+    int n = 0;
+    
+    while (n < BATCH_SIZE) {
+        int next = -1;
+        for (int s = 0; s < sc->num_sources; s++) {
+            if (sc->sources[s].has_head &&
+                (next < 0 || sc->sources[s].head.timestamp <
+                             sc->sources[next].head.timestamp)) {
+                next = s;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        
+        TraceSource *src = &sc->sources[next];
+        batch[n++] = src->head;
+        src->has_head = read_record(src->fp, &src->head);
+        src->head.source = (unsigned char)next;
+    }
+    
+    return n;
+}
+
+/**
+ * Run a decoded batch through the shared cache
+ */
+void simulate_shared_batch(SharedCache *sc, CacheLine **cache, CacheConfig *config,
+                           TraceRecord *batch, int n, CacheStats *stats, int quiet) {
+    unsigned int all_ways = (1u << config->associativity) - 1;
+    
+    for (int i = 0; i < n; i++) {
+        TraceRecord *rec = &batch[i];
+        int victim;
+        int hit = access_cache(cache, config, rec->type, rec->address, all_ways,
+                               rec->source, &victim, stats);
+        if (hit < 0) {
+            continue;
+        }
+        
+        record_access(&sc->source_stats[rec->source], rec->type, hit);
+        if (victim >= 0 && victim != rec->source) {
+            sc->stolen[victim][rec->source]++;
+        }
+        if (!quiet) {
+            print_access(stdout, config, rec->type, rec->address, hit);
+        }
+    }
+}
+
+/**
+ * Simulate every interleaved source through the shared cache
+ */
+void run_shared(SharedCache *sc, CacheLine **cache, CacheConfig *config,
+                CacheStats *stats, int quiet) {
+    TraceRecord *batch = (TraceRecord *)malloc(BATCH_SIZE * sizeof(TraceRecord));
+    if (batch == NULL) {
+        fprintf(stderr, "Error: Failed to allocate trace batch\n");
+        exit(1);
+    }
+    
+    for (;;) {
+        int n = sc->by_timestamp ? fill_batch_timestamp(sc, batch)
+                                 : fill_batch_ratio(sc, batch);
+        if (n == 0) {
+            break;
+        }
+        simulate_shared_batch(sc, cache, config, batch, n, stats, quiet);
+    }
+    
+    free(batch);
+}
+
+/**
+ * Print per-source statistics and cross-source evictions
+ */
+void print_shared_report(SharedCache *sc, SimOptions *opts) {
+    printf("\n");
+    printf("Per-Source Statistics\n");
+    printf("==============================\n");
+    printf("Source Accesses   Hits       Hit rate Lost       Stolen     Trace\n");
+    for (int s = 0; s < sc->num_sources; s++) {
+        CacheStats *ss = &sc->source_stats[s];
+        int total = ss->hits + ss->misses;
+        int lost = 0;
+        int stolen = 0;
+        for (int o = 0; o < sc->num_sources; o++) {
+            lost += sc->stolen[s][o];
+            stolen += sc->stolen[o][s];
+        }
+        printf("%-6d %-10d %-10d %6.2f%%  %-10d %-10d %s\n", s, total, ss->hits,
+               total > 0 ? (100.0 * ss->hits / total) : 0.0, lost, stolen,
+               opts->source_path[s]);
+    }
+    
+    printf("\n");
+    printf("Stolen Evictions (row = victim, column = evictor)\n");
+    printf("==============================\n");
+    printf("      ");
+    for (int o = 0; o < sc->num_sources; o++) {
+        printf(" %10d", o);
+    }
+    printf("\n");
+    for (int s = 0; s < sc->num_sources; s++) {
+        printf("%-6d", s);
+        for (int o = 0; o < sc->num_sources; o++) {
+            printf(" %10d", sc->stolen[s][o]);
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * Close the trace files of an interleaved run
+ */
+void free_shared(SharedCache *sc) {
+    for (int s = 0; s < sc->num_sources; s++) {
+        fclose(sc->sources[s].fp);
+    }
+}
+
+/**
+ * Validate cache configuration parameters
+ */
+int validate_config(CacheConfig *config) {
+    // Check range limits
+    if (config->num_sets <= 0 || config->num_sets > MAX_CACHE_SETS) {
+        fprintf(stderr, "Error: Number of sets must be 1-%d\n", MAX_CACHE_SETS);
+        return 0;
+    }
+    
+    if (config->associativity <= 0 || config->associativity > MAX_ASSOCIATIVITY) {
+        fprintf(stderr, "Error: Associativity must be 1-%d\n", MAX_ASSOCIATIVITY);
+        return 0;
+    }
+    
+    if (config->line_size < 8 || config->line_size > MAX_LINE_SIZE) {
+        fprintf(stderr, "Error: Line size must be 8-%d bytes\n", MAX_LINE_SIZE);
+        return 0;
+    }
+    
+    // Check power of 2
+    if ((config->num_sets & (config->num_sets - 1)) != 0) {
+        fprintf(stderr, "Error: Number of sets must be a power of 2\n");
+        return 0;
+    }
+    
+    if ((config->line_size & (config->line_size - 1)) != 0) {
+        fprintf(stderr, "Error: Line size must be a power of 2\n");
+        return 0;
+    }
+    
+    return 1;
+}
+
+/**
+ * Read a configuration list: one "sets ways line_size [output_file]" per line
+ *
+ * Blank lines and lines starting with '#' are ignored. Returns 0 on error.
+ */
+int load_configs(ConfigSweep *sweep, const char *path) {
+    FILE *fp = fopen(path, "r");
+    char line[512];
+    
+    memset(sweep, 0, sizeof(*sweep));
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Cannot open config list %s\n", path);
+        return 0;
+    }
+    
+    while (fgets(line, sizeof(line), fp)) {
+        CacheConfig *config = &sweep->configs[sweep->num_configs];
+        char output[256];
+        int fields;
+        
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        if (sweep->num_configs == MAX_CONFIGS) {
+            fprintf(stderr, "Error: At most %d configurations\n", MAX_CONFIGS);
+            fclose(fp);
+            return 0;
+        }
+        
+        fields = sscanf(line, "%d %d %d %255s", &config->num_sets, &config->associativity,
+                        &config->line_size, output);
+        if (fields < 3) {
+            fprintf(stderr, "Error: Invalid configuration '%s'\n", strtok(line, "\r\n"));
+            fclose(fp);
+            return 0;
+        }
+        if (!validate_config(config)) {
+            fclose(fp);
+            return 0;
+        }
+        if (fields == 4) {
+            sweep->output[sweep->num_configs] = fopen(output, "w");
+            if (sweep->output[sweep->num_configs] == NULL) {
+                fprintf(stderr, "Error: Cannot create %s\n", output);
+                fclose(fp);
+                return 0;
+            }
+        }
+        
+        sweep->num_configs++;
+    }
+    fclose(fp);
+    
+    if (sweep->num_configs == 0) {
+        fprintf(stderr, "Error: No configurations in %s\n", path);
+        return 0;
+    }
+    
+    for (int c = 0; c < sweep->num_configs; c++) {
+        sweep->configs[c].offset_bits = log2_int(sweep->configs[c].line_size);
+        sweep->configs[c].index_bits = log2_int(sweep->configs[c].num_sets);
+    }
+    
+    return 1;
+}
+
+/**
+ * Allocate the lines of every configuration in one arena
+ */
+void init_sweep(ConfigSweep *sweep) {
+    size_t total_lines = 0;
+    size_t total_sets = 0;
+    
+    for (int c = 0; c < sweep->num_configs; c++) {
+        total_sets += sweep->configs[c].num_sets;
+        total_lines += (size_t)sweep->configs[c].num_sets * sweep->configs[c].associativity;
+    }
+    
+    // One allocation for all lines and one for all set pointers
+    sweep->arena = (CacheLine *)calloc(total_lines, sizeof(CacheLine));
+    sweep->set_table = (CacheLine **)malloc(total_sets * sizeof(CacheLine *));
+    if (sweep->arena == NULL || sweep->set_table == NULL) {
+        fprintf(stderr, "Error: Failed to allocate cache memory\n");
+        exit(1);
+    }
+    
+    CacheLine *lines = sweep->arena;
+    CacheLine **sets = sweep->set_table;
+    for (int c = 0; c < sweep->num_configs; c++) {
+        CacheConfig *config = &sweep->configs[c];
+        sweep->caches[c] = sets;
+        for (int i = 0; i < config->num_sets; i++) {
+            sets[i] = lines;
+            lines += config->associativity;
+        }
+        sets += config->num_sets;
+    }
+}
+
+/**
+ * Replay one batch of records on every configuration
+ *
+ * The batch is replayed configuration by configuration, so only one cache
+ * and the batch itself are live at a time.
+ */
+void simulate_sweep_batch(ConfigSweep *sweep, TraceRecord *batch, int n) {
+    for (int c = 0; c < sweep->num_configs; c++) {
+        CacheConfig *config = &sweep->configs[c];
+        CacheLine **cache = sweep->caches[c];
+        unsigned int all_ways = (1u << config->associativity) - 1;
+        
+        for (int i = 0; i < n; i++) {
+            TraceRecord *rec = &batch[i];
+            int hit = access_cache(cache, config, rec->type, rec->address, all_ways,
+                                   0, NULL, &sweep->stats[c]);
+            if (hit >= 0 && sweep->output[c] != NULL) {
+                print_access(sweep->output[c], config, rec->type, rec->address, hit);
+            }
+        }
+    }
+}
+
+/**
+ * Parse the trace from stdin once and drive every configuration from it
+ */
+void run_sweep(ConfigSweep *sweep) {
+    TraceRecord *batch = (TraceRecord *)malloc(BATCH_SIZE * sizeof(TraceRecord));
+    if (batch == NULL) {
+        fprintf(stderr, "Error: Failed to allocate trace batch\n");
+        exit(1);
+    }
+    
+    for (;;) {
+        int n = 0;
+        while (n < BATCH_SIZE && read_record(stdin, &batch[n])) {
+            n++;
+        }
+        if (n == 0) {
+            break;
+        }
+        simulate_sweep_batch(sweep, batch, n);
+    }
+    
+    free(batch);
+}
+
+/**
+ * Print one summary row per configuration
+ */
+void print_sweep_report(ConfigSweep *sweep) {
+    printf("Multi-Configuration Summary\n");
+    printf("==============================\n");
+    printf("Sets   Ways Line Size     Accesses   Hits       Hit rate Mem reads  Mem writes\n");
+    for (int c = 0; c < sweep->num_configs; c++) {
+        CacheConfig *config = &sweep->configs[c];
+        CacheStats *cs = &sweep->stats[c];
+        int total = cs->hits + cs->misses;
+        printf("%-6d %-4d %-4d %-9d %-10d %-10d %6.2f%%  %-10d %d\n",
+               config->num_sets, config->associativity, config->line_size,
+               config->num_sets * config->associativity * config->line_size,
+               total, cs->hits, total > 0 ? (100.0 * cs->hits / total) : 0.0,
+               cs->mem_reads, cs->mem_writes);
+    }
+}
+
+/**
+ * Close per-configuration output and free the arena
+ */
+void free_sweep(ConfigSweep *sweep) {
+    for (int c = 0; c < sweep->num_configs; c++) {
+        if (sweep->output[c] != NULL) {
+            fclose(sweep->output[c]);
+        }
+    }
+    free(sweep->arena);
+    free(sweep->set_table);
+}
+
+/**
+ * Assign configurations first..first+lanes-1 to the lanes of a group
+ */
+void init_lane_group(LaneGroup *g, ConfigSweep *sweep, int first, int lanes) {
+    int max_sets = 1;
+    
+    memset(g, 0, sizeof(*g));
+    g->num_lanes = lanes;
+    for (int l = 0; l < lanes; l++) {
+        CacheConfig *config = &sweep->configs[first + l];
+        g->config_index[l] = first + l;
+        g->offset_shift[l] = config->offset_bits;
+        g->tag_shift[l] = config->offset_bits + config->index_bits;
+        g->index_mask[l] = config->num_sets - 1;
+        g->two_way[l] = config->associativity == 2 ? -1 : 0;
+        if (config->num_sets > max_sets) {
+            max_sets = config->num_sets;
+        }
+    }
+    
+    size_t entries = (size_t)max_sets * SIMD_LANES;
+    g->tags0 = (unsigned int *)malloc(entries * sizeof(unsigned int));
+    g->tags1 = (unsigned int *)malloc(entries * sizeof(unsigned int));
+    g->lru = (unsigned int *)calloc(entries, sizeof(unsigned int));
+    if (g->tags0 == NULL || g->tags1 == NULL || g->lru == NULL) {
+        fprintf(stderr, "Error: Failed to allocate lane caches\n");
+        exit(1);
+    }
+    memset(g->tags0, 0xFF, entries * sizeof(unsigned int));
+    memset(g->tags1, 0xFF, entries * sizeof(unsigned int));
+}
+
+/**
+ * Scalar reference kernel: the lane engine one lane at a time
+ */
+void lane_batch_scalar(LaneGroup *g, const TraceRecord *batch, int n) {
+    for (int i = 0; i < n; i++) {
+        int is_write = batch[i].type == 'W' || batch[i].type == 'w';
+        unsigned int address = batch[i].address;
+        
+        g->writes += is_write;
+        for (int l = 0; l < SIMD_LANES; l++) {
+            unsigned int index = (address >> g->offset_shift[l]) & g->index_mask[l];
+            unsigned int tag = address >> g->tag_shift[l];
+            size_t pos = (size_t)index * SIMD_LANES + l;
+            int hit0 = g->tags0[pos] == tag;
+            int hit1 = g->two_way[l] && g->tags1[pos] == tag;
+            
+            if (hit0 || hit1) {
+                g->hits[l]++;
+                g->lru[pos] = hit0 ? 1 : 0;
+                continue;
+            }
+            g->misses[l]++;
+            if (is_write) {
+                continue;   // No write allocate
+            }
+            g->read_misses[l]++;
+            if (g->two_way[l] && g->lru[pos] == 1) {
+                g->tags1[pos] = tag;
+                g->lru[pos] = 0;
+            } else {
+                g->tags0[pos] = tag;
+                g->lru[pos] = 1;
+            }
+        }
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+/**
+ * AVX2 kernel: every lane's lookup, LRU and fill decision in vector
+ * registers, then one scalar store per lane and array
+ */
+__attribute__((target("avx2")))
+void lane_batch_avx2(LaneGroup *g, const TraceRecord *batch, int n) {
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi32(-1);
+    const __m256i offset_shift = _mm256_loadu_si256((const __m256i *)g->offset_shift);
+    const __m256i tag_shift = _mm256_loadu_si256((const __m256i *)g->tag_shift);
+    const __m256i index_mask = _mm256_loadu_si256((const __m256i *)g->index_mask);
+    const __m256i two_way = _mm256_loadu_si256((const __m256i *)g->two_way);
+    __m256i hits = zero;
+    __m256i misses = zero;
+    __m256i read_misses = zero;
+    unsigned int out0[SIMD_LANES];
+    unsigned int out1[SIMD_LANES];
+    unsigned int out_lru[SIMD_LANES];
+    unsigned int out_pos[SIMD_LANES];
+    
+    for (int i = 0; i < n; i++) {
+        int is_write = batch[i].type == 'W' || batch[i].type == 'w';
+        __m256i addr = _mm256_set1_epi32((int)batch[i].address);
+        __m256i index = _mm256_and_si256(_mm256_srlv_epi32(addr, offset_shift), index_mask);
+        __m256i tag = _mm256_srlv_epi32(addr, tag_shift);
+        __m256i pos = _mm256_add_epi32(_mm256_slli_epi32(index, 3), lane);
+        __m256i t0 = _mm256_i32gather_epi32((const int *)g->tags0, pos, 4);
+        __m256i t1 = _mm256_i32gather_epi32((const int *)g->tags1, pos, 4);
+        __m256i lru = _mm256_i32gather_epi32((const int *)g->lru, pos, 4);
+        
+        __m256i hit0 = _mm256_cmpeq_epi32(t0, tag);
+        __m256i hit1 = _mm256_and_si256(_mm256_cmpeq_epi32(t1, tag), two_way);
+        __m256i miss = _mm256_xor_si256(_mm256_or_si256(hit0, hit1), ones);
+        hits = _mm256_sub_epi32(hits, _mm256_xor_si256(miss, ones));
+        misses = _mm256_sub_epi32(misses, miss);
+        
+        // Read misses fill the LRU way; writes never allocate
+        __m256i fill0 = zero;
+        __m256i fill1 = zero;
+        if (!is_write) {
+            __m256i victim1 = _mm256_and_si256(_mm256_cmpeq_epi32(lru, one), two_way);
+            fill1 = _mm256_and_si256(victim1, miss);
+            fill0 = _mm256_andnot_si256(victim1, miss);
+            read_misses = _mm256_sub_epi32(read_misses, miss);
+            t0 = _mm256_blendv_epi8(t0, tag, fill0);
+            t1 = _mm256_blendv_epi8(t1, tag, fill1);
+        }
+        // The way just used becomes MRU: way 0 used -> evict 1 next, and back
+        lru = _mm256_blendv_epi8(lru, one, _mm256_or_si256(hit0, fill0));
+        lru = _mm256_blendv_epi8(lru, zero, _mm256_or_si256(hit1, fill1));
+        
+        _mm256_storeu_si256((__m256i *)out0, t0);
+        _mm256_storeu_si256((__m256i *)out1, t1);
+        _mm256_storeu_si256((__m256i *)out_lru, lru);
+        _mm256_storeu_si256((__m256i *)out_pos, pos);
+        for (int l = 0; l < SIMD_LANES; l++) {
+            g->tags0[out_pos[l]] = out0[l];
+            g->tags1[out_pos[l]] = out1[l];
+            g->lru[out_pos[l]] = out_lru[l];
+        }
+        g->writes += is_write;
+    }
+    
+    int counts[SIMD_LANES];
+    _mm256_storeu_si256((__m256i *)counts, hits);
+    for (int l = 0; l < SIMD_LANES; l++) {
+        g->hits[l] += counts[l];
+    }
+    _mm256_storeu_si256((__m256i *)counts, misses);
+    for (int l = 0; l < SIMD_LANES; l++) {
+        g->misses[l] += counts[l];
+    }
+    _mm256_storeu_si256((__m256i *)counts, read_misses);
+    for (int l = 0; l < SIMD_LANES; l++) {
+        g->read_misses[l] += counts[l];
+    }
+}
+#endif
+
+/**
+ * Simulate every configuration on lane groups, reading the trace from stdin
+ *
+ * SIMD_VALIDATE also replays each batch through access_cache() and reports
+ * any configuration whose statistics differ. Returns 0 on a mismatch.
+ */
+int run_simd_sweep(ConfigSweep *sweep, int mode) {
+    int num_groups = (sweep->num_configs + SIMD_LANES - 1) / SIMD_LANES;
+    LaneGroup *groups = (LaneGroup *)malloc(num_groups * sizeof(LaneGroup));
+    TraceRecord *batch = (TraceRecord *)malloc(BATCH_SIZE * sizeof(TraceRecord));
+    void (*kernel)(LaneGroup *, const TraceRecord *, int) = lane_batch_scalar;
+    int ok = 1;
+    
+    if (groups == NULL || batch == NULL) {
+        fprintf(stderr, "Error: Failed to allocate lane groups\n");
+        exit(1);
+    }
+#ifdef HAVE_X86_SIMD
+    if (mode != SIMD_SCALAR && __builtin_cpu_supports("avx2")) {
+        kernel = lane_batch_avx2;
+    }
+#endif
+    
+    for (int gi = 0; gi < num_groups; gi++) {
+        int first = gi * SIMD_LANES;
+        int lanes = sweep->num_configs - first < SIMD_LANES ? sweep->num_configs - first
+                                                             : SIMD_LANES;
+        init_lane_group(&groups[gi], sweep, first, lanes);
+    }
+    if (mode == SIMD_VALIDATE) {
+        init_sweep(sweep);
+    }
+    
+    for (;;) {
+        int n = 0;
+        while (n < BATCH_SIZE && read_record(stdin, &batch[n])) {
+            // Unknown access types leave every cache untouched
+            n += strchr("RrWw", batch[n].type) != NULL;
+        }
+        if (n == 0) {
+            break;
+        }
+        for (int gi = 0; gi < num_groups; gi++) {
+            kernel(&groups[gi], batch, n);
+        }
+        if (mode == SIMD_VALIDATE) {
+            simulate_sweep_batch(sweep, batch, n);
+        }
+    }
+    
+    for (int gi = 0; gi < num_groups; gi++) {
+        LaneGroup *g = &groups[gi];
+        for (int l = 0; l < g->num_lanes; l++) {
+            CacheStats lane_stats = { g->hits[l], g->misses[l], g->read_misses[l], g->writes };
+            CacheStats *ref = &sweep->stats[g->config_index[l]];
+            if (mode == SIMD_VALIDATE && memcmp(&lane_stats, ref, sizeof(CacheStats)) != 0) {
+                fprintf(stderr, "Error: Lane engine differs for configuration %d "
+                        "(hits %d vs %d, misses %d vs %d)\n", g->config_index[l],
+                        lane_stats.hits, ref->hits, lane_stats.misses, ref->misses);
+                ok = 0;
+            }
+            *ref = lane_stats;
+        }
+        free(g->tags0);
+        free(g->tags1);
+        free(g->lru);
+    }
+    
+    printf("SIMD lane engine:  %s, %d lane group%s%s\n\n",
+           kernel == lane_batch_scalar ? "scalar" : "AVX2", num_groups,
+           num_groups == 1 ? "" : "s",
+           mode == SIMD_VALIDATE ? (ok ? ", validated" : ", MISMATCH") : "");
+    free(groups);
+    free(batch);
+    return ok;
+}
+
+/**
+ * Monotonic wall-clock time in seconds
+ */
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Mark the CPUs of a sysfs cpulist ("0-3,8,10-11") in cpus
+ */
+void parse_cpulist(const char *list, unsigned char *cpus) {
+    while (*list != '\0' && *list != '\n') {
+        char *end;
+        int first = (int)strtol(list, &end, 10);
+        int last = first;
+        if (end == list) {
+            return;
+        }
+        if (*end == '-') {
+            list = end + 1;
+            last = (int)strtol(list, &end, 10);
+        }
+        for (int c = first; c <= last && c < MAX_NUMA_CPUS; c++) {
+            if (c >= 0) {
+                cpus[c] = 1;
+            }
+        }
+        list = *end == ',' ? end + 1 : end;
+    }
+}
+
+/**
+ * Discover NUMA nodes from sysfs and spread num_workers workers over them
+ *
+ * Workers go round-robin over the nodes, then over each node's CPUs, using
+ * only CPUs the process may run on. Without sysfs (or off Linux) every
+ * CPU counts as one node.
+ */
+void init_numa(NumaTopology *numa, int num_workers) {
+    static unsigned char node_cpus[MAX_NUMA_NODES][MAX_NUMA_CPUS];
+    unsigned char allowed[MAX_NUMA_CPUS];
+    int node_count[MAX_NUMA_NODES];
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    
+    memset(numa, 0, sizeof(*numa));
+    memset(allowed, 0, sizeof(allowed));
+    for (int c = 0; c < online && c < MAX_NUMA_CPUS; c++) {
+        allowed[c] = 1;
+    }
+#ifdef __linux__
+    cpu_set_t mask;
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        for (int c = 0; c < MAX_NUMA_CPUS && c < CPU_SETSIZE; c++) {
+            allowed[c] = CPU_ISSET(c, &mask) ? 1 : 0;
+        }
+    }
+#endif
+    
+    for (int id = 0; id < 256 && numa->num_nodes < MAX_NUMA_NODES; id++) {
+        char path[64];
+        char list[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) {
+            continue;
+        }
+        if (fgets(list, sizeof(list), fp) != NULL) {
+            int n = numa->num_nodes;
+            memset(node_cpus[n], 0, MAX_NUMA_CPUS);
+            parse_cpulist(list, node_cpus[n]);
+            node_count[n] = 0;
+            for (int c = 0; c < MAX_NUMA_CPUS; c++) {
+                node_cpus[n][c] &= allowed[c];
+                node_count[n] += node_cpus[n][c];
+            }
+            if (node_count[n] > 0) {
+                numa->node_id[n] = id;
+                numa->num_nodes++;
+            }
+        }
+        fclose(fp);
+    }
+    if (numa->num_nodes == 0) {
+        memcpy(node_cpus[0], allowed, MAX_NUMA_CPUS);
+        node_count[0] = 0;
+        for (int c = 0; c < MAX_NUMA_CPUS; c++) {
+            node_count[0] += allowed[c];
+        }
+        if (node_count[0] == 0) {
+            node_cpus[0][0] = 1;
+            node_count[0] = 1;
+        }
+        numa->num_nodes = 1;
+    }
+    
+    numa->num_workers = num_workers;
+    numa->cpu = (int *)malloc(num_workers * sizeof(int));
+    numa->node = (int *)malloc(num_workers * sizeof(int));
+    numa->accesses = (unsigned long long *)calloc(num_workers, sizeof(unsigned long long));
+    if (numa->cpu == NULL || numa->node == NULL || numa->accesses == NULL) {
+        fprintf(stderr, "Error: Failed to allocate NUMA placement\n");
+        exit(1);
+    }
+    for (int w = 0; w < num_workers; w++) {
+        int n = w % numa->num_nodes;
+        int k = (w / numa->num_nodes) % node_count[n];
+        int c = 0;
+        while (!node_cpus[n][c] || k-- > 0) {
+            c++;
+        }
+        numa->node[w] = n;
+        numa->cpu[w] = c;
+    }
+    for (int n = 0; n < numa->num_nodes; n++) {
+        pthread_mutex_init(&numa->replica_lock[n], NULL);
+    }
+}
+
+/**
+ * Pin the calling thread to its worker's CPU, so that the memory it touches
+ * first is allocated on that CPU's node
+ */
+void numa_pin(NumaTopology *numa, int worker) {
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(numa->cpu[worker], &mask);
+    sched_setaffinity(0, sizeof(mask), &mask);
+#else
+    (void)numa;
+    (void)worker;
+#endif
+}
+
+/**
+ * Replicate shared read-only traces on every node if the copies take at
+ * most half of the free memory
+ */
+void numa_plan_replication(NumaTopology *numa, SweepJobs *jobs) {
+    unsigned long long bytes = 0;
+    long pages = sysconf(_SC_AVPHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    
+    for (int t = 0; t < jobs->num_traces; t++) {
+        bytes += (unsigned long long)jobs->traces[t].count * sizeof(TraceRecord);
+    }
+    numa->replicate = numa->num_nodes > 1 && pages > 0 && page_size > 0 &&
+                      bytes * (numa->num_nodes - 1) <=
+                      (unsigned long long)pages * page_size / 2;
+}
+
+/**
+ * A worker's view of a decoded trace: the copy on its own node, made on
+ * first use by that worker (so it is allocated locally)
+ */
+TraceRecord *numa_local_records(NumaTopology *numa, TraceBuffer *tb, int worker) {
+    if (numa == NULL || !numa->replicate || numa->node[worker] == tb->node ||
+        tb->count == 0) {
+        return tb->records;
+    }
+    
+    int n = numa->node[worker];
+    pthread_mutex_lock(&numa->replica_lock[n]);
+    if (tb->replicas[n] == NULL) {
+        TraceRecord *copy = (TraceRecord *)malloc(tb->count * sizeof(TraceRecord));
+        if (copy != NULL) {
+            memcpy(copy, tb->records, tb->count * sizeof(TraceRecord));
+        }
+        tb->replicas[n] = copy;
+    }
+    pthread_mutex_unlock(&numa->replica_lock[n]);
+    
+    return tb->replicas[n] != NULL ? tb->replicas[n] : tb->records;
+}
+
+/**
+ * Print per-node workers, accesses and throughput over seconds of wall time
+ */
+void print_numa_report(NumaTopology *numa, double seconds) {
+    if (seconds <= 0.0) {
+        seconds = 1e-9;
+    }
+    for (int n = 0; n < numa->num_nodes; n++) {
+        unsigned long long accesses = 0;
+        int workers = 0;
+        for (int w = 0; w < numa->num_workers; w++) {
+            if (numa->node[w] == n) {
+                accesses += numa->accesses[w];
+                workers++;
+            }
+        }
+        fprintf(stderr, "NUMA node %d: %d workers, %llu accesses, %.2f M accesses/s%s\n",
+                numa->node_id[n], workers, accesses, accesses / seconds / 1e6,
+                numa->replicate ? ", traces replicated" : "");
+    }
+}
+
+/**
+ * Free placement state
+ */
+void free_numa(NumaTopology *numa) {
+    for (int n = 0; n < numa->num_nodes; n++) {
+        pthread_mutex_destroy(&numa->replica_lock[n]);
+    }
+    free(numa->cpu);
+    free(numa->node);
+    free(numa->accesses);
+}
+
+/**
+ * Start a pool of num_workers workers that will call run_job(ctx, job, worker)
+ */
+void init_pool(JobPool *pool, int num_workers, int num_jobs,
+               void (*run_job)(void *, int, int), void *ctx) {
+    pool->num_workers = num_workers;
+    pool->run_job = run_job;
+    pool->ctx = ctx;
+    pool->numa = NULL;
+    pool->deques = (JobDeque *)calloc(num_workers, sizeof(JobDeque));
+    if (pool->deques == NULL) {
+        fprintf(stderr, "Error: Failed to allocate job pool\n");
+        exit(1);
+    }
+    
+    for (int w = 0; w < num_workers; w++) {
+        pool->deques[w].jobs = (int *)malloc((num_jobs + 1) * sizeof(int));
+        if (pool->deques[w].jobs == NULL) {
+            fprintf(stderr, "Error: Failed to allocate job pool\n");
+            exit(1);
+        }
+        pthread_mutex_init(&pool->deques[w].lock, NULL);
+    }
+}
+
+/**
+ * Take a job from the bottom of a worker's own deque, or steal one from the
+ * top of another's; returns -1 once every deque is empty
+ */
+int pool_next_job(JobPool *pool, int worker) {
+    for (int i = 0; i < pool->num_workers; i++) {
+        int victim = (worker + i) % pool->num_workers;
+        JobDeque *dq = &pool->deques[victim];
+        int job = -1;
+        
+        pthread_mutex_lock(&dq->lock);
+        if (dq->top < dq->bottom) {
+            job = victim == worker ? dq->jobs[--dq->bottom] : dq->jobs[dq->top++];
+        }
+        pthread_mutex_unlock(&dq->lock);
+        
+        if (job >= 0) {
+            pool->deques[worker].executed++;
+            if (victim != worker) {
+                pool->deques[worker].stolen++;
+            }
+            return job;
+        }
+    }
+    
+    return -1;
+}
+
+/**
+ * Pool worker thread: run jobs until none are left anywhere
+ */
+void *pool_worker(void *arg) {
+    PoolArg *pa = (PoolArg *)arg;
+    int job;
+    
+    if (pa->pool->numa != NULL) {
+        numa_pin(pa->pool->numa, pa->worker);
+    }
+    while ((job = pool_next_job(pa->pool, pa->worker)) >= 0) {
+        pa->pool->run_job(pa->pool->ctx, job, pa->worker);
+    }
+    
+    return NULL;
+}
+
+/**
+ * Run jobs order[0..num_jobs) on the pool and wait for all of them
+ *
+ * Jobs are dealt round-robin in the given order, so listing expensive jobs
+ * first starts them early; stealing then evens out the tail. No job is
+ * added once the pool starts, so an empty pool means all work is claimed.
+ */
+void pool_run(JobPool *pool, const int *order, int num_jobs) {
+    for (int w = 0; w < pool->num_workers; w++) {
+        pool->deques[w].top = 0;
+        pool->deques[w].bottom = 0;
+    }
+    // Deal in reverse so each owner pops its first-dealt (costliest) job first
+    for (int j = num_jobs - 1; j >= 0; j--) {
+        JobDeque *dq = &pool->deques[j % pool->num_workers];
+        dq->jobs[dq->bottom++] = order[j];
+    }
+    
+    pthread_t *threads = (pthread_t *)malloc(pool->num_workers * sizeof(pthread_t));
+    PoolArg *args = (PoolArg *)malloc(pool->num_workers * sizeof(PoolArg));
+    if (threads == NULL || args == NULL) {
+        fprintf(stderr, "Error: Failed to allocate worker threads\n");
+        exit(1);
+    }
+    for (int w = 0; w < pool->num_workers; w++) {
+        args[w].pool = pool;
+        args[w].worker = w;
+        if (pthread_create(&threads[w], NULL, pool_worker, &args[w]) != 0) {
+            fprintf(stderr, "Error: Failed to start worker thread\n");
+            exit(1);
+        }
+    }
+    for (int w = 0; w < pool->num_workers; w++) {
+        pthread_join(threads[w], NULL);
+    }
+    free(threads);
+    free(args);
+}
+
+/**
+ * Free pool deques
+ */
+void free_pool(JobPool *pool) {
+    for (int w = 0; w < pool->num_workers; w++) {
+        pthread_mutex_destroy(&pool->deques[w].lock);
+        free(pool->deques[w].jobs);
+    }
+    free(pool->deques);
+}
+
+/**
+ * Read a list of trace paths, one per line ('#' starts a comment)
+ */
+int load_sweep_traces(SweepJobs *jobs, const char *path) {
+    FILE *fp = fopen(path, "r");
+    char line[512];
+    
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Cannot open trace list %s\n", path);
+        return 0;
+    }
+    
+    while (fgets(line, sizeof(line), fp)) {
+        char *name = strtok(line, " \t\r\n");
+        if (name == NULL || name[0] == '#') {
+            continue;
+        }
+        if (jobs->num_traces == MAX_SWEEP_TRACES) {
+            fprintf(stderr, "Error: At most %d sweep traces\n", MAX_SWEEP_TRACES);
+            fclose(fp);
+            return 0;
+        }
+        jobs->traces[jobs->num_traces].path = strdup(name);
+        jobs->num_traces++;
+    }
+    fclose(fp);
+    
+    if (jobs->num_traces == 0) {
+        fprintf(stderr, "Error: No traces in %s\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Pool job: simulate one (trace, configuration) pair on a private cache
+ */
+void sweep_job(void *ctx, int job, int worker) {
+    SweepJobs *jobs = (SweepJobs *)ctx;
+    TraceBuffer *tb = &jobs->traces[job / jobs->configs->num_configs];
+    CacheConfig config = jobs->configs->configs[job % jobs->configs->num_configs];
+    CacheStats *stats = &jobs->results[job];
+    unsigned int all_ways = (1u << config.associativity) - 1;
+    TraceRecord *records = numa_local_records(jobs->numa, tb, worker);
+    CacheLine **cache;
+    
+    init_cache(&cache, &config);
+    for (int i = 0; i < tb->count; i++) {
+        access_cache(cache, &config, records[i].type, records[i].address,
+                     all_ways, 0, NULL, stats);
+    }
+    free_cache(cache, config.num_sets);
+    if (jobs->numa != NULL) {
+        jobs->numa->accesses[worker] += tb->count;
+    }
+}
+
+/**
+ * Create the result cache directory if needed
+ */
+int init_result_cache(ResultCache *rc, const char *dir, int max_entries) {
+    struct stat st;
+    
+    rc->dir = dir;
+    rc->max_entries = max_entries > 0 ? max_entries : DEFAULT_RESULT_CACHE_ENTRIES;
+    rc->hits = 0;
+    rc->misses = 0;
+    if (mkdir(dir, 0777) != 0 && (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode))) {
+        fprintf(stderr, "Error: Cannot create result cache %s\n", dir);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Mark a result cache file as just used
+ */
+void touch_cache_file(const char *path) {
+    utimensat(AT_FDCWD, path, NULL, 0);
+}
+
+/**
+ * Path of the index entry that remembers the content hash of a trace path
+ */
+void trace_index_path(ResultCache *rc, const char *path, char *entry, size_t size) {
+    snprintf(entry, size, "%s/%016llx.idx", rc->dir,
+             fnv1a(0xcbf29ce484222325ULL, (const unsigned char *)path, strlen(path)));
+}
+
+/**
+ * Look up the remembered content hash of a trace without reading it
+ *
+ * The hash of each path is remembered in an index entry together with the
+ * file's size, inode, and mtime and ctime in nanoseconds. ctime also catches
+ * a rewrite that restores mtime. The stamp taken here is kept in tb, so a
+ * trace hashed later while it is decoded is indexed under the state it had
+ * before it was read. Returns 1 and sets tb->hash on a hit.
+ */
+int trace_hash_lookup(ResultCache *rc, TraceBuffer *tb) {
+    char entry[1024];
+    char line[1024];
+    struct stat st;
+    long long size;
+    long long inode;
+    long long mtime;
+    long long ctime;
+    unsigned long long cached;
+    
+    if (stat(tb->path, &st) != 0) {
+        return 0;
+    }
+    tb->stamp[0] = (long long)st.st_size;
+    tb->stamp[1] = (long long)st.st_ino;
+    tb->stamp[2] = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    tb->stamp[3] = (long long)st.st_ctim.tv_sec * 1000000000LL + st.st_ctim.tv_nsec;
+    tb->stamped = 1;
+    trace_index_path(rc, tb->path, entry, sizeof(entry));
+    FILE *fp = fopen(entry, "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    int found = fgets(line, sizeof(line), fp) != NULL &&
+                sscanf(line, "%lld %lld %lld %lld %llx", &size, &inode, &mtime, &ctime,
+                       &cached) == 5 &&
+                fgets(line, sizeof(line), fp) != NULL;
+    fclose(fp);
+    line[strcspn(line, "\r\n")] = '\0';
+    if (found && size == tb->stamp[0] && inode == tb->stamp[1] && mtime == tb->stamp[2] &&
+        ctime == tb->stamp[3] && strcmp(line, tb->path) == 0) {
+        touch_cache_file(entry);
+        tb->hash = cached;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Remember a trace's content hash under the stamp taken by trace_hash_lookup
+ */
+void trace_hash_store(ResultCache *rc, TraceBuffer *tb) {
+    char entry[1024];
+    char tmp[1100];
+    
+    if (!tb->stamped) {
+        return;
+    }
+    trace_index_path(rc, tb->path, entry, sizeof(entry));
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", entry, (long)getpid());
+    FILE *fp = fopen(tmp, "w");
+    if (fp != NULL) {
+        fprintf(fp, "%lld %lld %lld %lld %016llx\n%s\n", tb->stamp[0], tb->stamp[1],
+                tb->stamp[2], tb->stamp[3], tb->hash, tb->path);
+        fclose(fp);
+        rename(tmp, entry);
+    }
+}
+
+/**
+ * Path of the result entry for a trace hash and a canonical geometry
+ */
+void result_cache_path(ResultCache *rc, unsigned long long hash, CacheConfig *config,
+                       char *path, size_t size) {
+    snprintf(path, size, "%s/%016llx-s%d-w%d-l%d.res", rc->dir, hash, config->num_sets,
+             config->associativity, config->line_size);
+}
+
+/**
+ * Look up stored results; entries from another simulator version are removed
+ */
+int result_cache_get(ResultCache *rc, unsigned long long hash, CacheConfig *config,
+                     CacheStats *stats) {
+    char path[1100];
+    int version = 0;
+    int found = 0;
+    
+    result_cache_path(rc, hash, config, path, sizeof(path));
+    FILE *fp = fopen(path, "r");
+    if (fp != NULL) {
+        found = fscanf(fp, "cache_simulator result v%d\nhits %d misses %d mem_reads %d "
+                       "mem_writes %d", &version, &stats->hits, &stats->misses,
+                       &stats->mem_reads, &stats->mem_writes) == 5;
+        fclose(fp);
+        if (found && version != RESULT_CACHE_VERSION) {
+            remove(path);
+            found = 0;
+        }
+    }
+    
+    if (found) {
+        touch_cache_file(path);
+    } else {
+        memset(stats, 0, sizeof(*stats));
+    }
+    return found;
+}
+
+/**
+ * Store the results of one trace and geometry
+ */
+void result_cache_put(ResultCache *rc, unsigned long long hash, CacheConfig *config,
+                      CacheStats *stats) {
+    char path[1100];
+    char tmp[1200];
+    
+    result_cache_path(rc, hash, config, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+    FILE *fp = fopen(tmp, "w");
+    if (fp == NULL) {
+        return;
+    }
+    fprintf(fp, "cache_simulator result v%d\nhits %d misses %d mem_reads %d mem_writes %d\n",
+            RESULT_CACHE_VERSION, stats->hits, stats->misses, stats->mem_reads,
+            stats->mem_writes);
+    fclose(fp);
+    rename(tmp, path);
+}
+
+/**
+ * A result cache file and its last use
+ */
+typedef struct {
+    char name[256];
+    long long mtime;        // Nanoseconds
+} CacheEntry;
+
+/**
+ * Order cache entries from least to most recently used
+ */
+int compare_cache_entries(const void *a, const void *b) {
+    long long x = ((const CacheEntry *)a)->mtime;
+    long long y = ((const CacheEntry *)b)->mtime;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Remove the least recently used entries beyond max_entries
+ */
+void evict_result_cache(ResultCache *rc) {
+    DIR *dir = opendir(rc->dir);
+    struct dirent *de;
+    CacheEntry *entries = NULL;
+    int count = 0;
+    int capacity = 0;
+    char path[1100];
+    
+    if (dir == NULL) {
+        return;
+    }
+    while ((de = readdir(dir)) != NULL) {
+        size_t len = strlen(de->d_name);
+        struct stat st;
+        if (len < 5 || len >= sizeof(entries->name) ||
+            (strcmp(de->d_name + len - 4, ".res") != 0 &&
+             strcmp(de->d_name + len - 4, ".idx") != 0)) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", rc->dir, de->d_name);
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 256;
+            entries = (CacheEntry *)realloc(entries, capacity * sizeof(CacheEntry));
+            if (entries == NULL) {
+                fprintf(stderr, "Error: Failed to allocate result cache index\n");
+                exit(1);
+            }
+        }
+        strcpy(entries[count].name, de->d_name);
+        entries[count].mtime = (long long)st.st_mtim.tv_sec * 1000000000LL +
+                               st.st_mtim.tv_nsec;
+        count++;
+    }
+    closedir(dir);
+    
+    if (count > rc->max_entries) {
+        qsort(entries, count, sizeof(CacheEntry), compare_cache_entries);
+        for (int e = 0; e < count - rc->max_entries; e++) {
+            snprintf(path, sizeof(path), "%s/%s", rc->dir, entries[e].name);
+            remove(path);
+        }
+    }
+    free(entries);
+}
+
+/**
+ * FNV-1a fingerprint of a job list: every trace path, then every geometry
+ *
+ * Written into partial result headers so merge can refuse shards of
+ * different sweeps that happen to have the same job count.
+ */
+unsigned long long job_list_fingerprint(SweepJobs *jobs, CacheConfig *configs,
+                                        int num_configs) {
+    unsigned long long h = 0xcbf29ce484222325ULL;
+    
+    for (int t = 0; t < jobs->num_traces; t++) {
+        const char *path = jobs->traces[t].path;
+        h = fnv1a(h, (const unsigned char *)path, strlen(path) + 1);
+    }
+    for (int c = 0; c < num_configs; c++) {
+        int geometry[3] = {configs[c].num_sets, configs[c].associativity,
+                           configs[c].line_size};
+        h = fnv1a(h, (const unsigned char *)geometry, sizeof(geometry));
+    }
+    return h;
+}
+
+/**
+ * Pool job: parse and decode one trace file into its shared buffer
+ */
+void decode_trace_job(void *ctx, int job, int worker) {
+    SweepJobs *jobs = (SweepJobs *)ctx;
+    TraceBuffer *tb = &jobs->traces[job];
+    FILE *fp = fopen(tb->path, "r");
+    int capacity = BATCH_SIZE;
+    int hashing = jobs->result_cache != NULL && !tb->has_hash;
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    
+    tb->node = jobs->numa != NULL ? jobs->numa->node[worker] : 0;
+    
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Cannot open trace %s\n", tb->path);
+        exit(1);
+    }
+    
+    tb->records = (TraceRecord *)malloc(capacity * sizeof(TraceRecord));
+    while (tb->records != NULL &&
+           read_record_hashed(fp, &tb->records[tb->count], hashing ? &hash : NULL)) {
+        if (++tb->count == capacity) {
+            capacity *= 2;
+            tb->records = (TraceRecord *)realloc(tb->records, capacity * sizeof(TraceRecord));
+        }
+    }
+    if (tb->records == NULL) {
+        fprintf(stderr, "Error: Failed to allocate trace %s\n", tb->path);
+        exit(1);
+    }
+    fclose(fp);
+    if (hashing) {
+        tb->hash = hash;
+        tb->has_hash = 1;
+        trace_hash_store(jobs->result_cache, tb);
+    }
+}
+
+/**
+ * Pool job: look up one trace's remembered content hash for the result cache
+ */
+void hash_trace_job(void *ctx, int job, int worker) {
+    SweepJobs *jobs = (SweepJobs *)ctx;
+    TraceBuffer *tb = &jobs->traces[job];
+    (void)worker;
+    
+    tb->has_hash = trace_hash_lookup(jobs->result_cache, tb);
+}
+
+/**
+ * Fetch stored results for this shard's jobs of one trace
+ *
+ * Marks the jobs found in cached and returns 1 if any job must still run.
+ */
+int lookup_trace_results(SweepJobs *jobs, int trace, unsigned char *cached,
+                         int shard_index, int shard_count) {
+    int num_configs = jobs->configs->num_configs;
+    TraceBuffer *tb = &jobs->traces[trace];
+    int uncached = 0;
+    
+    for (int c = 0; c < num_configs; c++) {
+        int j = trace * num_configs + c;
+        if (j % shard_count != shard_index) {
+            continue;
+        }
+        if (tb->has_hash && result_cache_get(jobs->result_cache, tb->hash,
+                                             &jobs->configs->configs[c],
+                                             &jobs->results[j])) {
+            cached[j] = 1;
+            jobs->result_cache->hits++;
+        } else {
+            uncached = 1;
+            jobs->result_cache->misses++;
+        }
+    }
+    return uncached;
+}
+
+/**
+ * Decode every trace, then simulate every (trace, config) pair on the pool
+ *
+ * Prints one CSV row per job in trace, then configuration, order. With
+ * shard_count > 0 only jobs j with j % shard_count == shard_index run, and
+ * the rows form a partial result file for run_merge.
+ */
+void run_pool_sweep(SweepJobs *jobs, int num_workers, int shard_index, int shard_count) {
+    int num_configs = jobs->configs->num_configs;
+    int num_jobs = jobs->num_traces * num_configs;
+    int *order = (int *)calloc(num_jobs, sizeof(int));
+    int num_decode = 0;
+    int num_run = 0;
+    int partial = shard_count > 0;
+    unsigned char *cached = (unsigned char *)calloc(num_jobs, 1);
+    unsigned char *hashed = (unsigned char *)calloc(jobs->num_traces, 1);
+    JobPool pool;
+    
+    if (!partial) {
+        shard_count = 1;
+    }
+    
+    jobs->results = (CacheStats *)calloc(num_jobs, sizeof(CacheStats));
+    if (order == NULL || jobs->results == NULL || cached == NULL || hashed == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sweep jobs\n");
+        exit(1);
+    }
+    
+    init_pool(&pool, num_workers, num_jobs, NULL, jobs);
+    pool.numa = jobs->numa;
+    
+    // Decode the traces this shard needs in parallel, then run the simulations
+    for (int t = 0; t < jobs->num_traces; t++) {
+        for (int c = 0; c < num_configs; c++) {
+            if ((t * num_configs + c) % shard_count == shard_index) {
+                order[num_decode++] = t;
+                break;
+            }
+        }
+    }
+    // Traces with a remembered hash are looked up without being read; the
+    // others are hashed while they are decoded and looked up afterwards
+    if (jobs->result_cache != NULL) {
+        int pending = 0;
+        pool.run_job = hash_trace_job;
+        pool_run(&pool, order, num_decode);
+        for (int i = 0; i < num_decode; i++) {
+            if (!jobs->traces[order[i]].has_hash ||
+                lookup_trace_results(jobs, order[i], cached, shard_index, shard_count)) {
+                order[pending++] = order[i];
+            }
+        }
+        num_decode = pending;
+    }
+    for (int i = 0; i < num_decode; i++) {
+        hashed[i] = jobs->traces[order[i]].has_hash;
+    }
+    pool.run_job = decode_trace_job;
+    pool_run(&pool, order, num_decode);
+    if (jobs->result_cache != NULL) {
+        for (int i = 0; i < num_decode; i++) {
+            if (!hashed[i]) {
+                lookup_trace_results(jobs, order[i], cached, shard_index, shard_count);
+            }
+        }
+    }
+    
+    // Longest traces first, so the costliest jobs start early
+    for (int t = 1; t < num_decode; t++) {
+        int trace = order[t];
+        int k = t;
+        while (k > 0 && jobs->traces[order[k - 1]].count < jobs->traces[trace].count) {
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = trace;
+    }
+    // Expand in place from the back; order[t] is overwritten by its own jobs
+    for (int t = num_decode - 1; t >= 0; t--) {
+        int trace = order[t];
+        for (int c = 0; c < num_configs; c++) {
+            order[t * num_configs + c] = trace * num_configs + c;
+        }
+    }
+    for (int k = 0; k < num_decode * num_configs; k++) {
+        if (order[k] % shard_count == shard_index && !cached[order[k]]) {
+            order[num_run++] = order[k];
+        }
+    }
+    for (int w = 0; w < num_workers; w++) {
+        pool.deques[w].executed = 0;
+        pool.deques[w].stolen = 0;
+    }
+    if (jobs->numa != NULL) {
+        numa_plan_replication(jobs->numa, jobs);
+    }
+    pool.run_job = sweep_job;
+    double start = now_seconds();
+    pool_run(&pool, order, num_run);
+    double seconds = now_seconds() - start;
+    
+    if (jobs->result_cache != NULL) {
+        for (int k = 0; k < num_run; k++) {
+            TraceBuffer *tb = &jobs->traces[order[k] / num_configs];
+            if (tb->has_hash) {
+                result_cache_put(jobs->result_cache, tb->hash,
+                                 &jobs->configs->configs[order[k] % num_configs],
+                                 &jobs->results[order[k]]);
+            }
+        }
+        evict_result_cache(jobs->result_cache);
+        fprintf(stderr, "Result cache: %d hits, %d misses\n", jobs->result_cache->hits,
+                jobs->result_cache->misses);
+    }
+    
+    if (partial) {
+        printf("# cache_simulator partial v%d shard %d/%d jobs %d list %016llx\n",
+               PARTIAL_VERSION, shard_index, shard_count, num_jobs,
+               job_list_fingerprint(jobs, jobs->configs->configs, num_configs));
+        printf("job,");
+    }
+    printf("trace,sets,ways,line_size,accesses,hits,misses,hit_rate,mem_reads,mem_writes\n");
+    for (int j = shard_index; j < num_jobs; j += shard_count) {
+        CacheConfig *config = &jobs->configs->configs[j % num_configs];
+        CacheStats *cs = &jobs->results[j];
+        int total = cs->hits + cs->misses;
+        if (partial) {
+            printf("%d,", j);
+        }
+        printf("%s,%d,%d,%d,%d,%d,%d,%.4f,%d,%d\n", jobs->traces[j / num_configs].path,
+               config->num_sets, config->associativity, config->line_size, total,
+               cs->hits, cs->misses, total > 0 ? (double)cs->hits / total : 0.0,
+               cs->mem_reads, cs->mem_writes);
+    }
+    
+    int steals = 0;
+    for (int w = 0; w < num_workers; w++) {
+        steals += pool.deques[w].stolen;
+    }
+    fprintf(stderr, "Sweep: %d jobs on %d workers, %d stolen\n", num_run, num_workers, steals);
+    if (jobs->numa != NULL) {
+        print_numa_report(jobs->numa, seconds);
+    }
+    
+    free_pool(&pool);
+    free(order);
+    free(cached);
+    free(hashed);
+}
+
+/**
+ * Pool job: stream one trace through the worker's reset cache
+ */
+void batch_job(void *ctx, int job, int worker) {
+    BatchRun *batch = (BatchRun *)ctx;
+    CacheConfig *config = batch->config;
+    unsigned int all_ways = (1u << config->associativity) - 1;
+    TraceBuffer *tb = &batch->jobs.traces[job];
+    FILE *fp = fopen(tb->path, "r");
+    TraceRecord rec;
+    int count = 0;
+    int hashing = batch->jobs.result_cache != NULL && !tb->has_hash;
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Cannot open trace %s\n", tb->path);
+        batch->failed[job] = 1;
+        return;
+    }
+    
+    // Allocated by the worker itself, so a pinned worker's cache is local
+    if (batch->caches[worker] == NULL) {
+        init_cache(&batch->caches[worker], config);
+    }
+    CacheLine **cache = batch->caches[worker];
+    reset_cache(cache, config);
+    while (read_record_hashed(fp, &rec, hashing ? &hash : NULL)) {
+        access_cache(cache, config, rec.type, rec.address, all_ways, 0, NULL,
+                     &batch->jobs.results[job]);
+        count++;
+    }
+    fclose(fp);
+    // Hashed while streaming, so the result is stored without a second read
+    if (hashing) {
+        tb->hash = hash;
+        tb->has_hash = 1;
+        trace_hash_store(batch->jobs.result_cache, tb);
+    }
+    if (batch->jobs.numa != NULL) {
+        batch->jobs.numa->accesses[worker] += count;
+    }
+}
+
+/**
+ * Run every trace of a manifest on the pool and print one CSV row per trace
+ * in manifest order (only this shard's traces when shard_count > 0)
+ */
+void run_batch(BatchRun *batch, int num_workers, int shard_index, int shard_count) {
+    int num_traces = batch->jobs.num_traces;
+    int *order = (int *)calloc(num_traces, sizeof(int));
+    ResultCache *cache = batch->jobs.result_cache;
+    int num_run = 0;
+    int partial = shard_count > 0;
+    JobPool pool;
+    
+    if (!partial) {
+        shard_count = 1;
+    }
+    
+    batch->jobs.results = (CacheStats *)calloc(num_traces, sizeof(CacheStats));
+    batch->failed = (unsigned char *)calloc(num_traces, 1);
+    batch->caches = (CacheLine ***)calloc(num_workers, sizeof(CacheLine **));
+    if (order == NULL || batch->jobs.results == NULL || batch->failed == NULL ||
+        batch->caches == NULL) {
+        fprintf(stderr, "Error: Failed to allocate batch state\n");
+        exit(1);
+    }
+    for (int t = shard_index; t < num_traces; t += shard_count) {
+        order[num_run++] = t;
+    }
+    
+    init_pool(&pool, num_workers, num_traces, batch_job, batch);
+    pool.numa = batch->jobs.numa;
+    if (cache != NULL) {
+        int pending = 0;
+        pool.run_job = hash_trace_job;
+        pool.ctx = &batch->jobs;
+        pool_run(&pool, order, num_run);
+        for (int k = 0; k < num_run; k++) {
+            TraceBuffer *tb = &batch->jobs.traces[order[k]];
+            if (tb->has_hash && result_cache_get(cache, tb->hash, batch->config,
+                                                 &batch->jobs.results[order[k]])) {
+                cache->hits++;
+            } else {
+                cache->misses++;
+                order[pending++] = order[k];
+            }
+        }
+        num_run = pending;
+        pool.run_job = batch_job;
+        pool.ctx = batch;
+    }
+    double start = now_seconds();
+    pool_run(&pool, order, num_run);
+    double seconds = now_seconds() - start;
+    free_pool(&pool);
+    
+    if (cache != NULL) {
+        for (int k = 0; k < num_run; k++) {
+            TraceBuffer *tb = &batch->jobs.traces[order[k]];
+            if (tb->has_hash && !batch->failed[order[k]]) {
+                result_cache_put(cache, tb->hash, batch->config,
+                                 &batch->jobs.results[order[k]]);
+            }
+        }
+        evict_result_cache(cache);
+        fprintf(stderr, "Result cache: %d hits, %d misses\n", cache->hits, cache->misses);
+    }
+    
+    if (partial) {
+        printf("# cache_simulator partial v%d shard %d/%d jobs %d list %016llx\n",
+               PARTIAL_VERSION, shard_index, shard_count, num_traces,
+               job_list_fingerprint(&batch->jobs, batch->config, 1));
+        printf("job,");
+    }
+    printf("trace,status,accesses,hits,misses,hit_rate,mem_reads,mem_writes\n");
+    for (int t = shard_index; t < num_traces; t += shard_count) {
+        CacheStats *cs = &batch->jobs.results[t];
+        int total = cs->hits + cs->misses;
+        if (partial) {
+            printf("%d,", t);
+        }
+        printf("%s,%s,%d,%d,%d,%.4f,%d,%d\n", batch->jobs.traces[t].path,
+               batch->failed[t] ? "unreadable" : "ok", total, cs->hits, cs->misses,
+               total > 0 ? (double)cs->hits / total : 0.0, cs->mem_reads, cs->mem_writes);
+    }
+    
+    if (batch->jobs.numa != NULL) {
+        print_numa_report(batch->jobs.numa, seconds);
+    }
+    
+    for (int w = 0; w < num_workers; w++) {
+        if (batch->caches[w] != NULL) {
+            free_cache(batch->caches[w], batch->config->num_sets);
+        }
+    }
+    free(batch->caches);
+    free(batch->failed);
+    free(order);
+}
+
+/**
+ * Free decoded traces and results
+ */
+void free_sweep_jobs(SweepJobs *jobs) {
+    for (int t = 0; t < jobs->num_traces; t++) {
+        free(jobs->traces[t].path);
+        free(jobs->traces[t].records);
+        for (int n = 0; n < MAX_NUMA_NODES; n++) {
+            free(jobs->traces[t].replicas[n]);
+        }
+    }
+    free(jobs->results);
+}
+
+/**
+ * Read one line, stripping the newline; 0 at end of file
+ */
+int read_line(FILE *fp, char *line, int size) {
+    if (fgets(line, size, fp) == NULL) {
+        return 0;
+    }
+    line[strcspn(line, "\r\n")] = '\0';
+    return 1;
+}
+
+/**
+ * Add the counts of one miss-ratio curve CSV to the running totals
+ *
+ * The first file fixes the rows; later files must list the same geometries
+ * in the same order.
+ */
+int merge_mrc_file(FILE *fp, const char *path, unsigned long long **sums, int **keys,
+                   int *num_rows, int first) {
+    char line[1024];
+    int row = 0;
+    
+    while (read_line(fp, line, sizeof(line))) {
+        int key[4];
+        unsigned long long count[6];
+        double rate;
+        double amat;
+        int exact;
+        if (sscanf(line, "%d,%d,%d,%d,%llu,%llu,%llu,%lf,%llu,%llu,%lf,%d", &key[0],
+                   &key[1], &key[2], &key[3], &count[0], &count[1], &count[2], &rate,
+                   &count[3], &count[4], &amat, &exact) != 12) {
+            fprintf(stderr, "Error: Malformed curve row in %s: %s\n", path, line);
+            return 0;
+        }
+        if (first) {
+            *sums = (unsigned long long *)realloc(*sums, (row + 1) * 6 * sizeof(**sums));
+            *keys = (int *)realloc(*keys, (row + 1) * 4 * sizeof(**keys));
+            if (*sums == NULL || *keys == NULL) {
+                fprintf(stderr, "Error: Failed to allocate merge state\n");
+                exit(1);
+            }
+            memcpy(&(*keys)[row * 4], key, sizeof(key));
+            memset(&(*sums)[row * 6], 0, 6 * sizeof(**sums));
+        } else if (row >= *num_rows || memcmp(&(*keys)[row * 4], key, sizeof(key)) != 0) {
+            fprintf(stderr, "Error: %s covers different geometries\n", path);
+            return 0;
+        }
+        count[5] = !exact;   // Files whose row is an estimate
+        for (int k = 0; k < 6; k++) {
+            (*sums)[row * 6 + k] += count[k];
+        }
+        row++;
+    }
+    
+    if (first) {
+        *num_rows = row;
+    } else if (row != *num_rows) {
+        fprintf(stderr, "Error: %s covers different geometries\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Collect the rows of one shard's partial result file by job index
+ *
+ * Every file must carry the shard count and job-list fingerprint of the
+ * first one.
+ */
+int merge_partial_file(FILE *fp, const char *path, char ***rows, int *num_jobs,
+                       int *num_shards, unsigned long long *list, char *header,
+                       int first) {
+    char line[1024];
+    int version = 0;
+    int index;
+    int count;
+    int jobs;
+    unsigned long long fingerprint;
+    
+    if (!read_line(fp, line, sizeof(line)) ||
+        sscanf(line, "# cache_simulator partial v%d", &version) != 1) {
+        fprintf(stderr, "Error: %s is not a partial result file\n", path);
+        return 0;
+    }
+    if (version != PARTIAL_VERSION) {
+        fprintf(stderr, "Error: %s has partial format v%d, expected v%d\n", path,
+                version, PARTIAL_VERSION);
+        return 0;
+    }
+    if (sscanf(line, "# cache_simulator partial v%d shard %d/%d jobs %d list %llx",
+               &version, &index, &count, &jobs, &fingerprint) != 5 ||
+        count <= 0 || index < 0 || index >= count || jobs < 0) {
+        fprintf(stderr, "Error: Malformed partial header in %s\n", path);
+        return 0;
+    }
+    if (!read_line(fp, line, sizeof(line)) || strncmp(line, "job,", 4) != 0) {
+        fprintf(stderr, "Error: %s has no column header\n", path);
+        return 0;
+    }
+    
+    if (first) {
+        strcpy(header, line + 4);
+        *num_jobs = jobs;
+        *num_shards = count;
+        *list = fingerprint;
+        *rows = (char **)calloc(jobs, sizeof(char *));
+        if (*rows == NULL) {
+            fprintf(stderr, "Error: Failed to allocate merge state\n");
+            exit(1);
+        }
+    } else if (jobs != *num_jobs || fingerprint != *list ||
+               strcmp(header, line + 4) != 0) {
+        fprintf(stderr, "Error: %s comes from a different job list\n", path);
+        return 0;
+    } else if (count != *num_shards) {
+        fprintf(stderr, "Error: %s is shard %d/%d, other files are of %d shards\n",
+                path, index, count, *num_shards);
+        return 0;
+    }
+    
+    while (read_line(fp, line, sizeof(line))) {
+        char *comma = strchr(line, ',');
+        int job = atoi(line);
+        if (comma == NULL || job < 0 || job >= jobs || job % count != index) {
+            fprintf(stderr, "Error: Malformed row in %s: %s\n", path, line);
+            return 0;
+        }
+        if ((*rows)[job] != NULL) {
+            fprintf(stderr, "Error: Job %d appears in more than one shard\n", job);
+            return 0;
+        }
+        (*rows)[job] = strdup(comma + 1);
+    }
+    return 1;
+}
+
+/**
+ * "merge" subcommand: combine the partial result files of --shard runs into
+ * the report an unsharded run prints, or sum miss-ratio curve CSVs (from
+ * --mrc over different traces) into one curve over the whole workload
+ */
+int run_merge(int argc, char *argv[]) {
+    int hit_latency = 1;
+    int mem_latency = 100;
+    int mode = 0;                   // 1 = partial results, 2 = curves
+    char header[1024];
+    char **rows = NULL;
+    int num_jobs = 0;
+    int num_shards = 0;
+    unsigned long long list = 0;
+    unsigned long long *sums = NULL;
+    int *keys = NULL;
+    int num_rows = 0;
+    int num_files = 0;
+    int ok = 1;
+    
+    for (int i = 0; i < argc && ok; i++) {
+        if (strcmp(argv[i], "--hit-latency") == 0 && i + 1 < argc) {
+            hit_latency = atoi(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "--mem-latency") == 0 && i + 1 < argc) {
+            mem_latency = atoi(argv[++i]);
+            continue;
+        }
+        
+        FILE *fp = fopen(argv[i], "r");
+        char line[1024];
+        if (fp == NULL) {
+            fprintf(stderr, "Error: Cannot open %s\n", argv[i]);
+            ok = 0;
+            break;
+        }
+        int c = fgetc(fp);
+        ungetc(c, fp);
+        int file_mode = c == '#' ? 1 : 2;
+        if (mode != 0 && file_mode != mode) {
+            fprintf(stderr, "Error: Cannot merge partial results with curves\n");
+            ok = 0;
+        } else if (file_mode == 1) {
+            ok = merge_partial_file(fp, argv[i], &rows, &num_jobs, &num_shards, &list,
+                                    header, mode == 0);
+        } else if (!read_line(fp, line, sizeof(line)) ||
+                   strncmp(line, "line_size,sets,ways,", 20) != 0) {
+            fprintf(stderr, "Error: %s is neither a partial result file nor a curve\n",
+                    argv[i]);
+            ok = 0;
+        } else {
+            ok = merge_mrc_file(fp, argv[i], &sums, &keys, &num_rows, mode == 0);
+        }
+        mode = file_mode;
+        num_files++;
+        fclose(fp);
+    }
+    
+    if (ok && num_files == 0) {
+        fprintf(stderr, "Error: merge needs at least one file\n");
+        ok = 0;
+    }
+    
+    if (ok && mode == 1) {
+        for (int j = 0; j < num_jobs && ok; j++) {
+            if (rows[j] == NULL) {
+                fprintf(stderr, "Error: Job %d is missing; is a shard file absent?\n", j);
+                ok = 0;
+            }
+        }
+        if (ok) {
+            printf("%s\n", header);
+            for (int j = 0; j < num_jobs; j++) {
+                printf("%s\n", rows[j]);
+            }
+        }
+    } else if (ok) {
+        printf("line_size,sets,ways,size_bytes,accesses,hits,misses,miss_rate,"
+               "mem_reads,mem_writes,amat,exact\n");
+        for (int r = 0; r < num_rows; r++) {
+            unsigned long long *sum = &sums[r * 6];
+            double miss_rate = sum[0] > 0 ? (double)sum[2] / sum[0] : 0.0;
+            printf("%d,%d,%d,%d,%llu,%llu,%llu,%.6f,%llu,%llu,%.3f,%d\n", keys[r * 4],
+                   keys[r * 4 + 1], keys[r * 4 + 2], keys[r * 4 + 3], sum[0], sum[1],
+                   sum[2], miss_rate, sum[3], sum[4], hit_latency + miss_rate * mem_latency,
+                   sum[5] == 0);
+        }
+    }
+    
+    for (int j = 0; j < num_jobs; j++) {
+        free(rows[j]);
+    }
+    free(rows);
+    free(sums);
+    free(keys);
+    return ok ? 0 : 1;
+}
+
+/**
+ * Pool job: replay one shard's records; no other shard touches its sets
+ */
+void shard_job(void *ctx, int job, int worker) {
+    ShardedRun *run = (ShardedRun *)ctx;
+    unsigned int all_ways = (1u << run->config->associativity) - 1;
+    
+    if (run->numa != NULL) {
+        run->numa->accesses[worker] += run->shard_start[job + 1] - run->shard_start[job];
+    }
+    
+    for (int k = run->shard_start[job]; k < run->shard_start[job + 1]; k++) {
+        TraceRecord *rec = &run->records[run->order[k]];
+        run->results[run->order[k]] = (signed char)access_cache(
+            run->cache, run->config, rec->type, rec->address, all_ways, 0, NULL,
+            &run->shard_stats[job]);
+    }
+}
+
+/**
+ * Simulate stdin on num_threads threads by splitting the cache's sets
+ *
+ * Each chunk is scattered by set index (a counting pass, a prefix sum and
+ * a stable placement pass), the shards run on the pool, and the per-access
+ * stream is printed in trace order afterwards. Sets never interact, so the
+ * results equal the sequential run.
+ */
+void run_sharded(CacheLine **cache, CacheConfig *config, CacheTotals *totals,
+                 int num_threads, int quiet, NumaTopology *numa) {
+    static ShardedRun run;
+    JobPool pool;
+    int shard_order[MAX_CACHE_SETS];
+    double start = now_seconds();
+    
+    run.cache = cache;
+    run.numa = numa;
+    run.config = config;
+    run.num_shards = 1;
+    while (run.num_shards < num_threads * SHARDS_PER_THREAD &&
+           run.num_shards < config->num_sets) {
+        run.num_shards *= 2;
+    }
+    
+    run.records = (TraceRecord *)malloc(SHARD_CHUNK * sizeof(TraceRecord));
+    run.order = (int *)malloc(SHARD_CHUNK * sizeof(int));
+    run.results = (signed char *)malloc(SHARD_CHUNK);
+    run.shard_stats = (CacheStats *)calloc(run.num_shards, sizeof(CacheStats));
+    run.shard_totals = (CacheTotals *)calloc(run.num_shards, sizeof(CacheTotals));
+    if (run.records == NULL || run.order == NULL || run.results == NULL ||
+        run.shard_stats == NULL || run.shard_totals == NULL) {
+        fprintf(stderr, "Error: Failed to allocate shard buffers\n");
+        exit(1);
+    }
+    init_pool(&pool, num_threads, run.num_shards, shard_job, &run);
+    pool.numa = numa;
+    
+    for (;;) {
+        int n = 0;
+        while (n < SHARD_CHUNK && read_record(stdin, &run.records[n])) {
+            n++;
+        }
+        if (n == 0) {
+            break;
+        }
+        
+        // Radix scatter of record positions by shard
+        memset(run.shard_start, 0, (run.num_shards + 1) * sizeof(int));
+        for (int i = 0; i < n; i++) {
+            int shard = (run.records[i].address >> config->offset_bits) & (run.num_shards - 1);
+            run.shard_start[shard + 1]++;
+        }
+        for (int sh = 0; sh < run.num_shards; sh++) {
+            run.shard_start[sh + 1] += run.shard_start[sh];
+            shard_order[sh] = run.shard_start[sh];
+        }
+        for (int i = 0; i < n; i++) {
+            int shard = (run.records[i].address >> config->offset_bits) & (run.num_shards - 1);
+            run.order[shard_order[shard]++] = i;
+        }
+        
+        for (int sh = 0; sh < run.num_shards; sh++) {
+            shard_order[sh] = sh;
+        }
+        pool_run(&pool, shard_order, run.num_shards);
+        
+        // A chunk's counts fit in int; the run's go to 64-bit totals
+        for (int sh = 0; sh < run.num_shards; sh++) {
+            run.shard_totals[sh].hits += run.shard_stats[sh].hits;
+            run.shard_totals[sh].misses += run.shard_stats[sh].misses;
+            run.shard_totals[sh].mem_reads += run.shard_stats[sh].mem_reads;
+            run.shard_totals[sh].mem_writes += run.shard_stats[sh].mem_writes;
+        }
+        memset(run.shard_stats, 0, run.num_shards * sizeof(CacheStats));
+        
+        if (!quiet) {
+            for (int i = 0; i < n; i++) {
+                if (run.results[i] >= 0) {
+                    print_access(stdout, config, run.records[i].type, run.records[i].address,
+                                 run.results[i]);
+                }
+            }
+        }
+    }
+    
+    for (int sh = 0; sh < run.num_shards; sh++) {
+        totals->hits += run.shard_totals[sh].hits;
+        totals->misses += run.shard_totals[sh].misses;
+        totals->mem_reads += run.shard_totals[sh].mem_reads;
+        totals->mem_writes += run.shard_totals[sh].mem_writes;
+    }
+    if (numa != NULL) {
+        print_numa_report(numa, now_seconds() - start);
+    }
+    
+    free_pool(&pool);
+    free(run.records);
+    free(run.order);
+    free(run.results);
+    free(run.shard_stats);
+    free(run.shard_totals);
+}
+
+/**
+ * Per-set LRU stacks and hit-depth histograms (Mattson stack algorithm)
+ */
+typedef struct {
+    int depth;                  // Deepest associativity reported
+    unsigned int *tags;         // [set * depth + position], MRU first
+    int *used;                  // Valid entries per set
+    unsigned long long read_hits[MAX_STACK_DEPTH + 1];   // By 1-based depth
+    unsigned long long write_hits[MAX_STACK_DEPTH + 1];
+    unsigned long long reads;
+    unsigned long long writes;
+} StackDistance;
+
+/**
+ * Allocate empty stacks for every set
+ */
+void init_stack_distance(StackDistance *sd, CacheConfig *config, int depth) {
+    memset(sd, 0, sizeof(*sd));
+    sd->depth = depth;
+    sd->tags = (unsigned int *)malloc((size_t)config->num_sets * depth * sizeof(unsigned int));
+    sd->used = (int *)calloc(config->num_sets, sizeof(int));
+    if (sd->tags == NULL || sd->used == NULL) {
+        fprintf(stderr, "Error: Failed to allocate LRU stacks\n");
+        exit(1);
+    }
+}
+
+/**
+ * Record one access: find the tag's stack depth and move it to the top
+ *
+ * An access at depth d hits in every cache with d or more ways. Read misses
+ * push the tag; writes follow no-write-allocate, so a write found nowhere in
+ * the stack leaves it unchanged.
+ */
+void stack_access(StackDistance *sd, CacheConfig *config, char access_type,
+                  unsigned int address) {
+    unsigned int index = (address >> config->offset_bits) & ((1 << config->index_bits) - 1);
+    unsigned int tag = address >> (config->offset_bits + config->index_bits);
+    unsigned int *stack = &sd->tags[(size_t)index * sd->depth];
+    int is_write = access_type == 'W' || access_type == 'w';
+    int pos = 0;
+    
+    if (!is_write && access_type != 'R' && access_type != 'r') {
+        return;
+    }
+    
+    while (pos < sd->used[index] && stack[pos] != tag) {
+        pos++;
+    }
+    
+    if (is_write) {
+        sd->writes++;
+    } else {
+        sd->reads++;
+    }
+    
+    if (pos < sd->used[index]) {
+        if (is_write) {
+            sd->write_hits[pos + 1]++;
+        } else {
+            sd->read_hits[pos + 1]++;
+        }
+    } else if (is_write) {
+        return;
+    } else if (sd->used[index] < sd->depth) {
+        sd->used[index]++;   // Miss: grow the stack, else drop its bottom
+    } else {
+        pos = sd->depth - 1;
+    }
+    
+    memmove(&stack[1], &stack[0], pos * sizeof(unsigned int));
+    stack[0] = tag;
+}
+
+/**
+ * Hits and memory reads of a cache with the given number of ways
+ */
+void stack_distance_counts(StackDistance *sd, int ways, unsigned long long *hits,
+                           unsigned long long *mem_reads) {
+    unsigned long long read_hits = 0;
+    
+    *hits = 0;
+    for (int d = 1; d <= ways; d++) {
+        read_hits += sd->read_hits[d];
+        *hits += sd->read_hits[d] + sd->write_hits[d];
+    }
+    *mem_reads = sd->reads - read_hits;
+}
+
+/**
+ * Whether the counts for the given number of ways are exact
+ *
+ * A write that hits below that depth misses in the smaller cache, which
+ * does not allocate it, while the stack still moves it to the top. From
+ * then on the smaller cache no longer holds the top of the stack.
+ */
+int stack_distance_exact(StackDistance *sd, int ways) {
+    for (int d = ways + 1; d <= sd->depth; d++) {
+        if (sd->write_hits[d] > 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Print hit and miss counts for every associativity up to the stack depth
+ */
+void print_stack_distance_report(StackDistance *sd, CacheConfig *config) {
+    unsigned long long total = sd->reads + sd->writes;
+    
+    printf("LRU Stack-Distance Results (%d sets, %d-byte lines)\n",
+           config->num_sets, config->line_size);
+    printf("==============================\n");
+    printf("Ways  Size       Hits       Misses     Hit rate Mem reads  Mem writes Exact\n");
+    for (int d = 1; d <= sd->depth; d++) {
+        unsigned long long hits;
+        unsigned long long mem_reads;
+        stack_distance_counts(sd, d, &hits, &mem_reads);
+        printf("%-5d %-10d %-10llu %-10llu %6.2f%%  %-10llu %-10llu %s\n", d,
+               config->num_sets * d * config->line_size, hits, total - hits,
+               total > 0 ? (100.0 * hits / total) : 0.0, mem_reads, sd->writes,
+               stack_distance_exact(sd, d) ? "yes" : "no");
+    }
+    
+    printf("\nHit depth  Reads      Writes\n");
+    for (int d = 1; d <= sd->depth; d++) {
+        if (sd->read_hits[d] > 0 || sd->write_hits[d] > 0) {
+            printf("%-10d %-10llu %llu\n", d, sd->read_hits[d], sd->write_hits[d]);
+        }
+    }
+}
+
+/**
+ * Free LRU stacks
+ */
+void free_stack_distance(StackDistance *sd) {
+    free(sd->tags);
+    free(sd->used);
+}
+
+/**
+ * LRU sets of every power-of-two set count, sharing one line address per
+ * access; level L has 2^L sets
+ */
+typedef struct {
+    int associativity;
+    unsigned int *lines;        // Line addresses, MRU first, all levels
+    unsigned int *level_lines[SET_LEVELS];
+    int *used;                  // Valid entries per set, all levels
+    int *level_used[SET_LEVELS];
+    CacheStats stats[SET_LEVELS];
+    unsigned char *unpruned;    // Per set, all levels: inclusion may not hold
+    unsigned char *level_unpruned[SET_LEVELS];
+} AllSets;
+
+/**
+ * Allocate every level in one arena
+ */
+void init_all_sets(AllSets *as, int associativity) {
+    int total_sets = (1 << SET_LEVELS) - 1;
+    
+    memset(as, 0, sizeof(*as));
+    as->associativity = associativity;
+    as->lines = (unsigned int *)malloc((size_t)total_sets * associativity * sizeof(unsigned int));
+    as->used = (int *)calloc(total_sets, sizeof(int));
+    as->unpruned = (unsigned char *)calloc(total_sets, 1);
+    if (as->lines == NULL || as->used == NULL || as->unpruned == NULL) {
+        fprintf(stderr, "Error: Failed to allocate set levels\n");
+        exit(1);
+    }
+    
+    for (int l = 0; l < SET_LEVELS; l++) {
+        as->level_lines[l] = as->lines + (size_t)((1 << l) - 1) * associativity;
+        as->level_used[l] = as->used + (1 << l) - 1;
+        as->level_unpruned[l] = as->unpruned + (1 << l) - 1;
+    }
+}
+
+/**
+ * Look up line in one level and apply LRU; returns 1 on a hit
+ *
+ * With search == 0 the line is known to be absent and the lookup is skipped.
+ */
+int all_sets_level(AllSets *as, int level, unsigned int line, int is_write, int search) {
+    unsigned int set = line & ((1u << level) - 1);
+    unsigned int *stack = &as->level_lines[level][(size_t)set * as->associativity];
+    int *used = &as->level_used[level][set];
+    int pos = *used;
+    
+    if (search) {
+        pos = 0;
+        while (pos < *used && stack[pos] != line) {
+            pos++;
+        }
+    }
+    
+    int hit = pos < *used;
+    if (!hit) {
+        if (is_write) {
+            return 0;   // No write allocate
+        }
+        if (*used < as->associativity) {
+            (*used)++;
+        } else {
+            pos = as->associativity - 1;
+        }
+    }
+    
+    memmove(&stack[1], &stack[0], pos * sizeof(unsigned int));
+    stack[0] = line;
+    return hit;
+}
+
+/**
+ * Simulate one access at every set count
+ *
+ * Under LRU with allocation on every reference, a hit with 2^L sets implies
+ * a hit with 2^(L+1) sets: the coarse set's lines that map to a finer set
+ * are all held by it. Levels are visited finest first, so after a miss the
+ * next coarser level is known to miss and is not searched.
+ *
+ * Write misses do not allocate. A write that hits the finer set but misses
+ * the coarse one refreshes the line in the finer set only, after which the
+ * finer set may evict a line the coarse set keeps. That coarse set is then
+ * marked and always searched; every other set keeps the pruning.
+ */
+void all_sets_access(AllSets *as, CacheConfig *config, char access_type,
+                     unsigned int address) {
+    unsigned int line = address >> config->offset_bits;
+    int is_write = access_type == 'W' || access_type == 'w';
+    int finer_hit = 1;
+    
+    if (!is_write && access_type != 'R' && access_type != 'r') {
+        return;
+    }
+    
+    for (int l = SET_LEVELS - 1; l >= 0; l--) {
+        unsigned char *unpruned = &as->level_unpruned[l][line & ((1u << l) - 1)];
+        int hit = all_sets_level(as, l, line, is_write, finer_hit || *unpruned);
+        record_access(&as->stats[l], access_type, hit);
+        if (is_write && finer_hit && !hit && l < SET_LEVELS - 1) {
+            *unpruned = 1;
+        }
+        finer_hit = hit;
+    }
+}
+
+/**
+ * Print results for every set count
+ */
+void print_all_sets_report(AllSets *as, CacheConfig *config) {
+    printf("All-Sets Results (%d ways, %d-byte lines)\n", as->associativity,
+           config->line_size);
+    printf("==============================\n");
+    printf("Sets   Size       Hits       Misses     Hit rate Mem reads  Mem writes\n");
+    for (int l = 0; l < SET_LEVELS; l++) {
+        CacheStats *cs = &as->stats[l];
+        int total = cs->hits + cs->misses;
+        printf("%-6d %-10d %-10d %-10d %6.2f%%  %-10d %d\n", 1 << l,
+               (1 << l) * as->associativity * config->line_size, cs->hits, cs->misses,
+               total > 0 ? (100.0 * cs->hits / total) : 0.0, cs->mem_reads, cs->mem_writes);
+    }
+}
+
+/**
+ * Free set levels
+ */
+void free_all_sets(AllSets *as) {
+    free(as->lines);
+    free(as->used);
+    free(as->unpruned);
+}
+
+/**
+ * Stack-distance profile of every geometry validate_config() accepts: one
+ * MAX_ASSOCIATIVITY-deep stack per set for each line size and set count
+ */
+typedef struct {
+    CacheConfig configs[LINE_LEVELS][SET_LEVELS];
+    StackDistance stacks[LINE_LEVELS][SET_LEVELS];
+} MrcProfile;
+
+/**
+ * Allocate stacks for every line size and set count
+ */
+void init_mrc(MrcProfile *mrc) {
+    for (int l = 0; l < LINE_LEVELS; l++) {
+        for (int s = 0; s < SET_LEVELS; s++) {
+            CacheConfig *config = &mrc->configs[l][s];
+            config->num_sets = 1 << s;
+            config->associativity = MAX_ASSOCIATIVITY;
+            config->line_size = 8 << l;
+            config->offset_bits = log2_int(config->line_size);
+            config->index_bits = s;
+            init_stack_distance(&mrc->stacks[l][s], config, MAX_ASSOCIATIVITY);
+        }
+    }
+}
+
+/**
+ * Record one access in every stack
+ */
+void mrc_access(MrcProfile *mrc, char access_type, unsigned int address) {
+    for (int l = 0; l < LINE_LEVELS; l++) {
+        for (int s = 0; s < SET_LEVELS; s++) {
+            stack_access(&mrc->stacks[l][s], &mrc->configs[l][s], access_type, address);
+        }
+    }
+}
+
+/**
+ * Miss rate and AMAT of one geometry; AMAT = hit time + miss rate * memory time
+ *
+ * Returns 0 when the stack counts for this many ways are only an estimate.
+ */
+int mrc_point(MrcProfile *mrc, int l, int s, int ways, SimOptions *opts,
+              double *miss_rate, double *amat) {
+    StackDistance *sd = &mrc->stacks[l][s];
+    unsigned long long total = sd->reads + sd->writes;
+    unsigned long long hits;
+    unsigned long long mem_reads;
+    
+    stack_distance_counts(sd, ways, &hits, &mem_reads);
+    *miss_rate = total > 0 ? (double)(total - hits) / total : 0.0;
+    *amat = opts->hit_latency + *miss_rate * opts->mem_latency;
+    return stack_distance_exact(sd, ways);
+}
+
+/**
+ * Write one CSV row per line size, set count and associativity
+ */
+int write_mrc_csv(MrcProfile *mrc, SimOptions *opts, const char *path) {
+    FILE *fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Cannot create %s\n", path);
+        return 0;
+    }
+    
+    fprintf(fp, "line_size,sets,ways,size_bytes,accesses,hits,misses,miss_rate,"
+            "mem_reads,mem_writes,amat,exact\n");
+    for (int l = 0; l < LINE_LEVELS; l++) {
+        for (int s = 0; s < SET_LEVELS; s++) {
+            StackDistance *sd = &mrc->stacks[l][s];
+            for (int w = 1; w <= MAX_ASSOCIATIVITY; w++) {
+                unsigned long long total = sd->reads + sd->writes;
+                unsigned long long hits;
+                unsigned long long mem_reads;
+                double miss_rate;
+                double amat;
+                stack_distance_counts(sd, w, &hits, &mem_reads);
+                int exact = mrc_point(mrc, l, s, w, opts, &miss_rate, &amat);
+                fprintf(fp, "%d,%d,%d,%d,%llu,%llu,%llu,%.6f,%llu,%llu,%.3f,%d\n",
+                        8 << l, 1 << s, w, (8 << l) * (1 << s) * w, total, hits,
+                        total - hits, miss_rate, mem_reads, sd->writes, amat, exact);
+            }
+        }
+    }
+    
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    return 1;
+}
+
+/**
+ * Print the smallest configuration meeting the miss-rate or AMAT target
+ *
+ * Ties in total size go to fewer ways (a cheaper lookup), then to the lower
+ * miss rate.
+ */
+void print_sizing_recommendation(MrcProfile *mrc, SimOptions *opts) {
+    int best_l = -1;
+    int best_s = 0;
+    int best_w = 0;
+    int best_size = 0;
+    double best_miss = 0.0;
+    double best_amat = 0.0;
+    int best_exact = 1;
+    
+    for (int l = 0; l < LINE_LEVELS; l++) {
+        for (int s = 0; s < SET_LEVELS; s++) {
+            for (int w = 1; w <= MAX_ASSOCIATIVITY; w++) {
+                int size = (8 << l) * (1 << s) * w;
+                double miss_rate;
+                double amat;
+                int exact = mrc_point(mrc, l, s, w, opts, &miss_rate, &amat);
+                
+                if ((opts->target_miss > 0.0 && 100.0 * miss_rate > opts->target_miss) ||
+                    (opts->target_amat > 0.0 && amat > opts->target_amat)) {
+                    continue;
+                }
+                if (best_l < 0 || size < best_size ||
+                    (size == best_size && (w < best_w ||
+                                           (w == best_w && miss_rate < best_miss)))) {
+                    best_l = l;
+                    best_s = s;
+                    best_w = w;
+                    best_size = size;
+                    best_miss = miss_rate;
+                    best_amat = amat;
+                    best_exact = exact;
+                }
+            }
+        }
+    }
+    
+    printf("Cache Sizing Recommendation\n");
+    printf("==============================\n");
+    if (opts->target_miss > 0.0) {
+        printf("Target miss rate:  %.2f%%\n", opts->target_miss);
+    }
+    if (opts->target_amat > 0.0) {
+        printf("Target AMAT:       %.2f cycles (hit %d, memory %d)\n", opts->target_amat,
+               opts->hit_latency, opts->mem_latency);
+    }
+    if (best_l < 0) {
+        printf("No configuration within the simulator limits meets the target\n");
+        return;
+    }
+    printf("Number of sets:    %d\n", 1 << best_s);
+    printf("Set associativity: %d\n", best_w);
+    printf("Line size:         %d bytes\n", 8 << best_l);
+    printf("Total cache size:  %d bytes\n", best_size);
+    printf("Miss rate:         %.2f%%\n", 100.0 * best_miss);
+    printf("AMAT:              %.2f cycles\n", best_amat);
+    if (!best_exact) {
+        printf("Note: approximate; writes in the trace break LRU inclusion below %d ways\n",
+               MAX_ASSOCIATIVITY);
+    }
+}
+
+/**
+ * Free every stack
+ */
+void free_mrc(MrcProfile *mrc) {
+    for (int l = 0; l < LINE_LEVELS; l++) {
+        for (int s = 0; s < SET_LEVELS; s++) {
+            free_stack_distance(&mrc->stacks[l][s]);
+        }
+    }
+}
+
+/**
+ * LRU stack distances: the last access time of each line, and a Fenwick
+ * tree marking the times that are some line's last access
+ *
+ * The distance of an access is the number of marks after the line's last
+ * access time. Times are renumbered densely when the tree fills up.
+ *
+ * With SHARDS sampling only lines whose spatial hash falls below threshold
+ * are tracked. Each sampled access stands for 1 / rate accesses and its
+ * distance is scaled by 1 / rate. In fixed-size mode the threshold drops to
+ * the largest tracked hash whenever more than max_lines lines are tracked,
+ * and the lines at or above it are forgotten.
+ */
+typedef struct {
+    LineMap last_access;        // Line address -> last access time
+    unsigned int *tree;         // Fenwick tree over times, 1-based
+    unsigned int capacity;      // Times before the next compaction
+    unsigned int now;
+    double hist[REUSE_BUCKETS]; // Estimated accesses per distance bucket
+    double cold;
+    unsigned long long accesses;
+    int compactions;
+    int sampling;
+    unsigned int threshold;     // Track lines with hash < threshold
+    int max_lines;              // Fixed-size bound (0 = fixed rate)
+    unsigned int *heap_hash;    // Max-heap of tracked lines by hash
+    unsigned int *heap_line;
+    int heap_count;
+    unsigned long long sampled; // Accesses to tracked lines
+    double group_hist[SHARDS_GROUPS][REUSE_BUCKETS];
+    double group_total[SHARDS_GROUPS];
+} ReuseDistance;
+
+/**
+ * Allocate the tree for capacity times
+ */
+void init_reuse_distance(ReuseDistance *rd, unsigned int capacity) {
+    memset(rd, 0, sizeof(*rd));
+    linemap_init(&rd->last_access, 1024);
+    rd->capacity = capacity;
+    rd->threshold = SHARDS_MODULUS;
+    rd->tree = (unsigned int *)calloc(capacity + 1, sizeof(unsigned int));
+    if (rd->tree == NULL) {
+        fprintf(stderr, "Error: Failed to allocate reuse-distance tree\n");
+        exit(1);
+    }
+}
+
+/**
+ * Enable SHARDS sampling at a fixed rate, or with at most max_lines lines
+ */
+void init_shards(ReuseDistance *rd, double rate, int max_lines) {
+    rd->sampling = 1;
+    rd->threshold = rate > 0.0 ? (unsigned int)(rate * SHARDS_MODULUS) : SHARDS_MODULUS;
+    if (rd->threshold == 0) {
+        rd->threshold = 1;
+    }
+    
+    if (max_lines > 0) {
+        rd->max_lines = max_lines;
+        rd->heap_hash = (unsigned int *)malloc((max_lines + 1) * sizeof(unsigned int));
+        rd->heap_line = (unsigned int *)malloc((max_lines + 1) * sizeof(unsigned int));
+        if (rd->heap_hash == NULL || rd->heap_line == NULL) {
+            fprintf(stderr, "Error: Failed to allocate sample heap\n");
+            exit(1);
+        }
+    }
+}
+
+/**
+ * Spatial sampling hash of a line (32-bit finalizer mix)
+ */
+unsigned int shards_hash(unsigned int line) {
+    unsigned int h = line * 0x9E3779B1u;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+/**
+ * Add delta at a time
+ */
+void fenwick_add(ReuseDistance *rd, unsigned int time, int delta) {
+    for (unsigned int i = time + 1; i <= rd->capacity; i += i & -i) {
+        rd->tree[i] += delta;
+    }
+}
+
+/**
+ * Number of marks at times 0..time
+ */
+unsigned int fenwick_sum(ReuseDistance *rd, unsigned int time) {
+    unsigned int sum = 0;
+    for (unsigned int i = time + 1; i > 0; i -= i & -i) {
+        sum += rd->tree[i];
+    }
+    return sum;
+}
+
+/**
+ * Renumber last-access times to 0..lines-1, keeping their order
+ *
+ * A line's new time is its rank among the marked times. The tree doubles
+ * when more than half of it would be live after compaction.
+ */
+void compact_reuse_distance(ReuseDistance *rd) {
+    LineMap *map = &rd->last_access;
+    
+    for (unsigned int i = 0; i < map->capacity; i++) {
+        if (map->keys[i] != LINEMAP_EMPTY) {
+            map->values[i] = fenwick_sum(rd, map->values[i]) - 1;
+        }
+    }
+    
+    if (2 * map->count > rd->capacity) {
+        rd->capacity *= 2;
+        free(rd->tree);
+        rd->tree = (unsigned int *)malloc((rd->capacity + 1) * sizeof(unsigned int));
+        if (rd->tree == NULL) {
+            fprintf(stderr, "Error: Failed to allocate reuse-distance tree\n");
+            exit(1);
+        }
+    }
+    
+    // Linear-time build with times 0..count-1 marked
+    memset(rd->tree, 0, (rd->capacity + 1) * sizeof(unsigned int));
+    for (unsigned int i = 1; i <= rd->capacity; i++) {
+        rd->tree[i] += i <= map->count ? 1 : 0;
+        unsigned int parent = i + (i & -i);
+        if (parent <= rd->capacity) {
+            rd->tree[parent] += rd->tree[i];
+        }
+    }
+    
+    rd->now = map->count;
+    rd->compactions++;
+}
+
+/**
+ * Track a newly sampled line in fixed-size mode, forgetting the lines with
+ * the largest hashes while more than max_lines are tracked
+ */
+void shards_track(ReuseDistance *rd, unsigned int line, unsigned int hash) {
+    int i = rd->heap_count++;
+    
+    // Sift up
+    while (i > 0 && rd->heap_hash[(i - 1) / 2] < hash) {
+        rd->heap_hash[i] = rd->heap_hash[(i - 1) / 2];
+        rd->heap_line[i] = rd->heap_line[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    rd->heap_hash[i] = hash;
+    rd->heap_line[i] = line;
+    
+    while (rd->heap_count > rd->max_lines ||
+           (rd->heap_count > 0 && rd->heap_hash[0] >= rd->threshold)) {
+        unsigned int evict = rd->heap_line[0];
+        unsigned int *last = linemap_find(&rd->last_access, evict);
+        
+        rd->threshold = rd->heap_hash[0];
+        fenwick_add(rd, *last, -1);
+        linemap_remove(&rd->last_access, evict);
+        
+        // Move the last entry to the root and sift down
+        unsigned int h = rd->heap_hash[--rd->heap_count];
+        unsigned int l = rd->heap_line[rd->heap_count];
+        int pos = 0;
+        for (;;) {
+            int child = 2 * pos + 1;
+            if (child >= rd->heap_count) {
+                break;
+            }
+            if (child + 1 < rd->heap_count && rd->heap_hash[child + 1] > rd->heap_hash[child]) {
+                child++;
+            }
+            if (rd->heap_hash[child] <= h) {
+                break;
+            }
+            rd->heap_hash[pos] = rd->heap_hash[child];
+            rd->heap_line[pos] = rd->heap_line[child];
+            pos = child;
+        }
+        rd->heap_hash[pos] = h;
+        rd->heap_line[pos] = l;
+    }
+}
+
+/**
+ * Record one access at line granularity
+ */
+void reuse_access(ReuseDistance *rd, CacheConfig *config, char access_type,
+                  unsigned int address) {
+    unsigned int line = address >> config->offset_bits;
+    unsigned int hash = rd->sampling ? shards_hash(line) : 0;
+    int group = hash >> 29;
+    
+    if (access_type != 'R' && access_type != 'r' &&
+        access_type != 'W' && access_type != 'w') {
+        return;
+    }
+    
+    rd->accesses++;
+    if ((hash & (SHARDS_MODULUS - 1)) >= rd->threshold) {
+        return;
+    }
+    rd->sampled++;
+    
+    if (rd->now == rd->capacity) {
+        compact_reuse_distance(rd);
+    }
+    
+    double rate = (double)rd->threshold / SHARDS_MODULUS;
+    double weight = 1.0 / rate;
+    int bucket = 0;
+    unsigned int *last = linemap_find(&rd->last_access, line);
+    
+    if (last == NULL) {
+        rd->cold += weight;
+        bucket = -1;
+        last = linemap_insert(&rd->last_access, line);
+    } else {
+        unsigned int sampled = fenwick_sum(rd, rd->now - 1) - fenwick_sum(rd, *last);
+        double distance = sampled / rate;
+        while (bucket < REUSE_BUCKETS - 1 && (double)(1ULL << bucket) <= distance) {
+            bucket++;
+        }
+        rd->hist[bucket] += weight;
+        rd->group_hist[group][bucket] += weight;
+        fenwick_add(rd, *last, -1);
+    }
+    rd->group_total[group] += weight;
+    
+    *last = rd->now;
+    fenwick_add(rd, rd->now, 1);
+    rd->now++;
+    
+    if (bucket < 0 && rd->max_lines > 0) {
+        shards_track(rd, line, hash & (SHARDS_MODULUS - 1));
+    }
+}
+
+/**
+ * Print the distance histogram with the hit rate of a fully associative
+ * LRU cache holding as many lines as each bucket's upper bound
+ *
+ * Sampled profiles first apply the SHARDS adjustment: the difference
+ * between the real and the estimated access count is credited to the
+ * smallest distance, where sampling bias concentrates. The error column is
+ * the standard error of the hit rate across SHARDS_GROUPS independent
+ * spatial sub-samples.
+ */
+void print_reuse_distance_report(ReuseDistance *rd, CacheConfig *config) {
+    double within = 0.0;
+    double group_within[SHARDS_GROUPS] = {0};
+    double estimated = rd->cold;
+    
+    for (int b = 0; b < REUSE_BUCKETS; b++) {
+        estimated += rd->hist[b];
+    }
+    if (rd->sampling) {
+        rd->hist[0] += rd->accesses - estimated;
+        if (rd->hist[0] < 0.0) {
+            rd->hist[0] = 0.0;
+        }
+    }
+    
+    printf("Reuse Distance (%d-byte lines, fully associative LRU)\n", config->line_size);
+    printf("==============================\n");
+    printf("Accesses:          %llu\n", rd->accesses);
+    if (rd->sampling) {
+        printf("Sampling rate:     %.6f%s\n", (double)rd->threshold / SHARDS_MODULUS,
+               rd->max_lines > 0 ? " (final, fixed size)" : "");
+        printf("Sampled accesses:  %llu\n", rd->sampled);
+        printf("Tracked lines:     %u\n", rd->last_access.count);
+        printf("Cold misses (est): %.0f\n", rd->cold);
+        printf("\nDistance             Accesses     Lines  Hit rate  +/- Error\n");
+    } else {
+        printf("Distinct lines:    %u\n", rd->last_access.count);
+        printf("Cold misses:       %.0f\n", rd->cold);
+        printf("\nDistance             Accesses     Lines  Hit rate\n");
+    }
+    
+    for (int b = 0; b < REUSE_BUCKETS; b++) {
+        char range[32];
+        double mean = 0.0;
+        double var = 0.0;
+        int groups = 0;
+        
+        within += rd->hist[b];
+        for (int g = 0; g < SHARDS_GROUPS; g++) {
+            group_within[g] += rd->group_hist[g][b];
+        }
+        if (rd->hist[b] == 0.0) {
+            continue;
+        }
+        if (b == 0) {
+            snprintf(range, sizeof(range), "0");
+        } else {
+            snprintf(range, sizeof(range), "%llu-%llu", 1ULL << (b - 1), (1ULL << b) - 1);
+        }
+        printf("%-20s %-12.0f %-6llu %6.2f%%", range, rd->hist[b], 1ULL << b,
+               rd->accesses > 0 ? (100.0 * within / rd->accesses) : 0.0);
+        
+        if (!rd->sampling) {
+            printf("\n");
+            continue;
+        }
+        for (int g = 0; g < SHARDS_GROUPS; g++) {
+            if (rd->group_total[g] > 0.0) {
+                mean += group_within[g] / rd->group_total[g];
+                groups++;
+            }
+        }
+        mean /= groups > 0 ? groups : 1;
+        for (int g = 0; g < SHARDS_GROUPS; g++) {
+            if (rd->group_total[g] > 0.0) {
+                double d = group_within[g] / rd->group_total[g] - mean;
+                var += d * d;
+            }
+        }
+        printf("  %6.2f%%\n", groups > 1 ? 100.0 * sqrt(var / (groups - 1) / groups) : 0.0);
+    }
+}
+
+/**
+ * Free reuse-distance state
+ */
+void free_reuse_distance(ReuseDistance *rd) {
+    linemap_free(&rd->last_access);
+    free(rd->tree);
+    free(rd->heap_hash);
+    free(rd->heap_line);
+}
+
+/**
+ * Sparse reuse-time samples for StatStack (LRU) and StatCache (random)
+ *
+ * A sampled access sets a watchpoint on its line; the next access to the
+ * line resolves it with the reuse time, the number of accesses between
+ * the two plus one. Watchpoints still open at the end are dangling.
+ */
+typedef struct {
+    double rate;
+    unsigned long long now;
+    unsigned long long next_sample;
+    unsigned int rng;
+    LineMap watch;                  // Line -> index into start
+    unsigned long long *start;      // Access index of each watchpoint
+    int num_watches;
+    int watch_capacity;
+    unsigned long long *times;      // Resolved reuse times
+    int count;
+    int capacity;
+    int dangling;
+    double *stack_distance;         // Estimated stack distance per sorted time
+} StatStack;
+
+/**
+ * Fully associative random-replacement cache (evaluation reference)
+ */
+typedef struct {
+    LineMap slot_of;                // Line -> slot
+    unsigned int *lines;
+    unsigned int capacity;
+    unsigned int used;
+    unsigned int rng;
+    unsigned long long misses;
+} RandomCache;
+
+/**
+ * Uniform random number in (0, 1] from a 32-bit LCG
+ */
+double statstack_uniform(unsigned int *rng) {
+    *rng = *rng * 1664525u + 1013904223u;
+    return ((*rng >> 8) + 1) / 16777216.0;
+}
+
+/**
+ * Prepare an empty sample set; rate 0 means samples come from a file
+ */
+void init_statstack(StatStack *ss, double rate) {
+    memset(ss, 0, sizeof(*ss));
+    ss->rate = rate;
+    ss->rng = 12345u;
+    linemap_init(&ss->watch, 1024);
+    if (rate > 0.0) {
+        ss->next_sample = (unsigned long long)(-log(statstack_uniform(&ss->rng)) / rate);
+    }
+}
+
+/**
+ * Store one reuse time, or a dangling sample when time is 0
+ */
+void statstack_add(StatStack *ss, unsigned long long time) {
+    if (time == 0) {
+        ss->dangling++;
+        return;
+    }
+    if (ss->count == ss->capacity) {
+        ss->capacity = ss->capacity > 0 ? 2 * ss->capacity : 1024;
+        ss->times = (unsigned long long *)realloc(ss->times,
+                                                  ss->capacity * sizeof(unsigned long long));
+        if (ss->times == NULL) {
+            fprintf(stderr, "Error: Failed to allocate reuse samples\n");
+            exit(1);
+        }
+    }
+    ss->times[ss->count++] = time;
+}
+
+/**
+ * Observe one trace access: resolve a watchpoint on its line, and start a
+ * new one when the exponentially distributed sampling gap has elapsed
+ */
+void statstack_access(StatStack *ss, CacheConfig *config, char access_type,
+                      unsigned int address) {
+    unsigned int line = address >> config->offset_bits;
+    unsigned int *watch;
+    
+    if (access_type != 'R' && access_type != 'r' &&
+        access_type != 'W' && access_type != 'w') {
+        return;
+    }
+    
+    watch = linemap_find(&ss->watch, line);
+    if (watch != NULL) {
+        statstack_add(ss, ss->now - ss->start[*watch]);
+        linemap_remove(&ss->watch, line);
+    }
+    
+    if (ss->now == ss->next_sample) {
+        if (ss->num_watches == ss->watch_capacity) {
+            ss->watch_capacity = ss->watch_capacity > 0 ? 2 * ss->watch_capacity : 1024;
+            ss->start = (unsigned long long *)realloc(ss->start,
+                ss->watch_capacity * sizeof(unsigned long long));
+            if (ss->start == NULL) {
+                fprintf(stderr, "Error: Failed to allocate watchpoints\n");
+                exit(1);
+            }
+        }
+        ss->start[ss->num_watches] = ss->now;
+        *linemap_insert(&ss->watch, line) = ss->num_watches++;
+        ss->next_sample += 1 + (unsigned long long)(-log(statstack_uniform(&ss->rng)) /
+                                                    ss->rate);
+    }
+    
+    ss->now++;
+}
+
+/**
+ * Read reuse times from a file, one per line; 0 or '-' marks a dangling
+ * sample
+ */
+int load_reuse_samples(StatStack *ss, const char *path) {
+    FILE *fp = fopen(path, "r");
+    char line[128];
+    
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Cannot open reuse samples %s\n", path);
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long long time;
+        if (line[0] == '-') {
+            statstack_add(ss, 0);
+        } else if (sscanf(line, "%llu", &time) == 1) {
+            statstack_add(ss, time);
+        }
+    }
+    fclose(fp);
+    
+    if (ss->count + ss->dangling == 0) {
+        fprintf(stderr, "Error: No reuse samples in %s\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+int compare_reuse_times(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a;
+    unsigned long long y = *(const unsigned long long *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * Close open watchpoints and convert reuse times to stack distances
+ *
+ * Of the accesses between a reuse pair, the one k accesses before its end
+ * is the last access to its line inside the window exactly when its own
+ * reuse time exceeds k. So the expected stack distance of reuse time t is
+ * SD(t) = sum over k = 1..t-1 of P(reuse time > k), with dangling samples
+ * counted as infinite reuse times.
+ */
+void statstack_finish(StatStack *ss) {
+    double total = ss->count + ss->dangling;
+    double sd = 0.0;
+    unsigned long long k = 1;
+    
+    ss->dangling += ss->watch.count;
+    total += ss->watch.count;
+    
+    qsort(ss->times, ss->count, sizeof(unsigned long long), compare_reuse_times);
+    ss->stack_distance = (double *)malloc((ss->count + 1) * sizeof(double));
+    if (ss->stack_distance == NULL) {
+        fprintf(stderr, "Error: Failed to allocate stack distances\n");
+        exit(1);
+    }
+    
+    for (int i = 0; i < ss->count; i++) {
+        unsigned long long t = ss->times[i];
+        if (t > k) {
+            // i samples have reuse time < t, so P(reuse time > k') is fixed on [k, t)
+            sd += (t - k) * (total - i) / total;
+            k = t;
+        }
+        ss->stack_distance[i] = sd;
+    }
+}
+
+/**
+ * StatStack LRU miss ratio of a fully associative cache of lines lines
+ */
+double statstack_lru_miss(StatStack *ss, unsigned int lines) {
+    int misses = ss->dangling;
+    for (int i = 0; i < ss->count; i++) {
+        misses += ss->stack_distance[i] >= lines;
+    }
+    return (double)misses / (ss->count + ss->dangling);
+}
+
+/**
+ * StatCache random-replacement miss ratio: the fixed point of
+ * m = mean over samples of 1 - (1 - 1/lines)^((t - 1) m)
+ */
+double statcache_random_miss(StatStack *ss, unsigned int lines) {
+    double keep = log(1.0 - 1.0 / lines);
+    double m = 0.5;
+    
+    if (lines == 1) {
+        keep = -INFINITY;  // Every intervening miss evicts the only line
+    }
+    for (int iter = 0; iter < 100; iter++) {
+        double misses = ss->dangling;
+        for (int i = 0; i < ss->count; i++) {
+            double evictions = (ss->times[i] - 1) * m;
+            misses += evictions > 0.0 ? 1.0 - exp(evictions * keep) : 0.0;
+        }
+        double next = misses / (ss->count + ss->dangling);
+        if (fabs(next - m) < 1e-9) {
+            return next;
+        }
+        m = next;
+    }
+    return m;
+}
+
+/**
+ * Allocate an empty random-replacement cache
+ */
+void init_random_cache(RandomCache *rc, unsigned int capacity, unsigned int seed) {
+    memset(rc, 0, sizeof(*rc));
+    linemap_init(&rc->slot_of, 2 * capacity);
+    rc->capacity = capacity;
+    rc->rng = seed;
+    rc->lines = (unsigned int *)malloc(capacity * sizeof(unsigned int));
+    if (rc->lines == NULL) {
+        fprintf(stderr, "Error: Failed to allocate random cache\n");
+        exit(1);
+    }
+}
+
+/**
+ * Access a line, replacing a uniformly chosen line on a miss
+ */
+void random_cache_access(RandomCache *rc, unsigned int line) {
+    unsigned int slot;
+    
+    if (linemap_find(&rc->slot_of, line) != NULL) {
+        return;
+    }
+    rc->misses++;
+    if (rc->used < rc->capacity) {
+        slot = rc->used++;
+    } else {
+        rc->rng = rc->rng * 1664525u + 1013904223u;
+        slot = (unsigned int)(((unsigned long long)(rc->rng >> 8) * rc->capacity) >> 24);
+        linemap_remove(&rc->slot_of, rc->lines[slot]);
+    }
+    rc->lines[slot] = line;
+    *linemap_insert(&rc->slot_of, line) = slot;
+}
+
+/**
+ * Free a random-replacement cache
+ */
+void free_random_cache(RandomCache *rc) {
+    linemap_free(&rc->slot_of);
+    free(rc->lines);
+}
+
+/**
+ * Print estimated miss ratios per cache size, with simulated references
+ * (exact LRU reuse distances and random caches) when rd is not NULL
+ */
+void print_statstack_report(StatStack *ss, CacheConfig *config, double seconds,
+                            ReuseDistance *rd, RandomCache *random) {
+    double lru_err = 0.0;
+    double random_err = 0.0;
+    
+    printf("StatStack / StatCache Estimates (%d-byte lines, fully associative)\n",
+           config->line_size);
+    printf("==============================\n");
+    if (ss->rate > 0.0) {
+        printf("Accesses:          %llu\n", ss->now);
+    }
+    printf("Reuse samples:     %d (%d dangling)\n", ss->count + ss->dangling, ss->dangling);
+    printf("Estimation time:   %.2f ms\n", 1000.0 * seconds);
+    printf("\nLines  Size       LRU miss  Random miss");
+    printf(rd != NULL ? "  Sim LRU   Sim random\n" : "\n");
+    
+    unsigned long long within = 0;
+    for (int b = 0; b < STATSTACK_SIZES; b++) {
+        unsigned int lines = 1u << b;
+        double lru = statstack_lru_miss(ss, lines);
+        double rnd = statcache_random_miss(ss, lines);
+        printf("%-6u %-10u %7.2f%%  %9.2f%%", lines, lines * config->line_size,
+               100.0 * lru, 100.0 * rnd);
+        
+        if (rd == NULL) {
+            printf("\n");
+            continue;
+        }
+        // Distance bucket b holds distances below 2^b: hits with 2^b lines
+        within += (unsigned long long)rd->hist[b];
+        double sim_lru = rd->accesses > 0 ? 1.0 - (double)within / rd->accesses : 0.0;
+        double sim_rnd = rd->accesses > 0 ? (double)random[b].misses / rd->accesses : 0.0;
+        printf("  %7.2f%%  %9.2f%%\n", 100.0 * sim_lru, 100.0 * sim_rnd);
+        lru_err += fabs(lru - sim_lru);
+        random_err += fabs(rnd - sim_rnd);
+    }
+    
+    if (rd != NULL) {
+        printf("\nMean absolute error: LRU %.2f%%, random %.2f%%\n",
+               100.0 * lru_err / STATSTACK_SIZES, 100.0 * random_err / STATSTACK_SIZES);
+    }
+}
+
+/**
+ * Free sample storage
+ */
+void free_statstack(StatStack *ss) {
+    linemap_free(&ss->watch);
+    free(ss->start);
+    free(ss->times);
+    free(ss->stack_distance);
+}
+
+/**
+ * One round of a chunk-parallel run: consecutive chunks simulated at once,
+ * each but the first from an empty cache
+ */
+typedef struct {
+    CacheLine **cache;          // True state; chunk 0 runs on it directly
+    CacheConfig *config;
+    int num_chunks;
+    TraceRecord *records;       // Round in trace order
+    int count;
+    CacheLine ***spec;          // Speculative cache of each later chunk
+    CacheStats *spec_stats;     // Discarded; results are recounted
+    signed char *results;       // Per record: 1 hit, 0 miss, -1 skipped
+    unsigned char *converged;   // Per set, during reconciliation
+    CacheLine **shadow;         // Speculative replay during reconciliation
+    unsigned long long resimulated;
+    unsigned long long total;
+    NumaTopology *numa;         // NULL = no placement
+} ChunkedRun;
+
+/**
+ * Whether two sets behave identically from now on: the same valid tags at
+ * the same LRU ranks, wherever they sit
+ *
+ * Invalid ways always keep counter 0 in a single cache, so only valid
+ * lines need matching.
+ */
+int sets_equivalent(CacheLine *a, CacheLine *b, int associativity) {
+    int valid_a = 0;
+    int valid_b = 0;
+    
+    for (int i = 0; i < associativity; i++) {
+        valid_a += a[i].valid;
+        valid_b += b[i].valid;
+    }
+    if (valid_a != valid_b) {
+        return 0;
+    }
+    
+    for (int i = 0; i < associativity; i++) {
+        if (!a[i].valid) {
+            continue;
+        }
+        int j = find_way(b, associativity, a[i].tag);
+        if (j < 0 || b[j].lru_counter != a[i].lru_counter) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Pool job: simulate one chunk; chunk 0 starts from the true state and is
+ * exact, later chunks start empty
+ */
+void chunk_job(void *ctx, int job, int worker) {
+    ChunkedRun *run = (ChunkedRun *)ctx;
+    int chunk_size = (run->count + run->num_chunks - 1) / run->num_chunks;
+    int first = job * chunk_size;
+    int last = first + chunk_size < run->count ? first + chunk_size : run->count;
+    unsigned int all_ways = (1u << run->config->associativity) - 1;
+    CacheLine **cache;
+    
+    if (run->numa != NULL) {
+        run->numa->accesses[worker] += last > first ? last - first : 0;
+    }
+    
+    // Speculative caches are allocated by the worker that first runs them
+    if (job > 0 && run->spec[job] == NULL) {
+        init_cache(&run->spec[job], run->config);
+    }
+    cache = job == 0 ? run->cache : run->spec[job];
+    if (job > 0) {
+        reset_cache(cache, run->config);
+    }
+    for (int i = first; i < last; i++) {
+        run->results[i] = (signed char)access_cache(
+            cache, run->config, run->records[i].type, run->records[i].address, all_ways,
+            0, NULL, &run->spec_stats[job]);
+    }
+}
+
+/**
+ * Make chunk c exact once the true state before it is in run->cache
+ *
+ * Each set's accesses are replayed on the true state and, from empty, on a
+ * shadow of the speculative run until the two sets are equivalent. From
+ * then on the speculative results for that set are exact, and its final
+ * speculative state is the true final state.
+ */
+void reconcile_chunk(ChunkedRun *run, int c) {
+    CacheConfig *config = run->config;
+    int chunk_size = (run->count + run->num_chunks - 1) / run->num_chunks;
+    int first = c * chunk_size;
+    int last = first + chunk_size < run->count ? first + chunk_size : run->count;
+    unsigned int all_ways = (1u << config->associativity) - 1;
+    CacheStats scratch = {0, 0, 0, 0};
+    
+    memset(run->converged, 0, config->num_sets);
+    reset_cache(run->shadow, config);
+    
+    for (int i = first; i < last; i++) {
+        TraceRecord *rec = &run->records[i];
+        unsigned int index = (rec->address >> config->offset_bits) &
+                             ((1 << config->index_bits) - 1);
+        if (run->converged[index]) {
+            continue;
+        }
+        run->results[i] = (signed char)access_cache(run->cache, config, rec->type,
+                                                    rec->address, all_ways, 0, NULL, &scratch);
+        access_cache(run->shadow, config, rec->type, rec->address, all_ways, 0, NULL, &scratch);
+        run->resimulated++;
+        if (sets_equivalent(run->cache[index], run->shadow[index], config->associativity)) {
+            run->converged[index] = 1;
+        }
+    }
+    
+    for (int i = 0; i < config->num_sets; i++) {
+        if (run->converged[i]) {
+            memcpy(run->cache[i], run->spec[c][i], config->associativity * sizeof(CacheLine));
+        }
+    }
+}
+
+/**
+ * Simulate stdin in rounds of num_threads consecutive chunks
+ *
+ * The chunks of a round run in parallel on the pool, then are reconciled
+ * in order, so the results equal the sequential run exactly.
+ */
+void run_chunked(CacheLine **cache, CacheConfig *config, CacheStats *stats,
+                 int num_threads, int quiet, NumaTopology *numa) {
+    static ChunkedRun run;
+    JobPool pool;
+    int order[MAX_CORES];
+    int round_size = num_threads * TIME_CHUNK;
+    
+    double start = now_seconds();
+    
+    memset(&run, 0, sizeof(run));
+    run.cache = cache;
+    run.config = config;
+    run.numa = numa;
+    run.num_chunks = num_threads;
+    run.records = (TraceRecord *)malloc(round_size * sizeof(TraceRecord));
+    run.results = (signed char *)malloc(round_size);
+    run.converged = (unsigned char *)malloc(config->num_sets);
+    run.spec = (CacheLine ***)calloc(num_threads, sizeof(CacheLine **));
+    run.spec_stats = (CacheStats *)calloc(num_threads, sizeof(CacheStats));
+    if (run.records == NULL || run.results == NULL || run.converged == NULL ||
+        run.spec == NULL || run.spec_stats == NULL) {
+        fprintf(stderr, "Error: Failed to allocate chunk buffers\n");
+        exit(1);
+    }
+    init_cache(&run.shadow, config);
+    init_pool(&pool, num_threads, num_threads, chunk_job, &run);
+    pool.numa = numa;
+    for (int c = 0; c < num_threads; c++) {
+        order[c] = c;
+    }
+    
+    for (;;) {
+        run.count = 0;
+        while (run.count < round_size && read_record(stdin, &run.records[run.count])) {
+            run.count++;
+        }
+        if (run.count == 0) {
+            break;
+        }
+        
+        pool_run(&pool, order, run.num_chunks);
+        for (int c = 1; c < run.num_chunks; c++) {
+            reconcile_chunk(&run, c);
+        }
+        
+        for (int i = 0; i < run.count; i++) {
+            if (run.results[i] < 0) {
+                continue;
+            }
+            record_access(stats, run.records[i].type, run.results[i]);
+            if (!quiet) {
+                print_access(stdout, config, run.records[i].type, run.records[i].address,
+                             run.results[i]);
+            }
+        }
+        run.total += run.count;
+    }
+    
+    fprintf(stderr, "Chunk-parallel: %d chunks per round, %.2f%% of accesses re-simulated\n",
+            run.num_chunks, run.total > 0 ? 100.0 * run.resimulated / run.total : 0.0);
+    if (numa != NULL) {
+        print_numa_report(numa, now_seconds() - start);
+    }
+    
+    free_pool(&pool);
+    for (int c = 1; c < num_threads; c++) {
+        if (run.spec[c] != NULL) {
+            free_cache(run.spec[c], config->num_sets);
+        }
+    }
+    free_cache(run.shadow, config->num_sets);
+    free(run.spec);
+    free(run.spec_stats);
+    free(run.records);
+    free(run.results);
+    free(run.converged);
+}
+
+/**
+ * Initialize a multi-core system of private caches
+ */
+void init_multicore(MultiCore *mc, CacheConfig *config, int num_cores, int protocol) {
+    mc->config = config;
+    mc->num_cores = num_cores;
+    mc->protocol = protocol;
+    mc->sharing = NULL;
+    mc->filter = NULL;
+    mc->net = NULL;
+    mc->cycles = NULL;
+    mc->first_cycle = NULL;
+    memset(&mc->coherence, 0, sizeof(mc->coherence));
+    
+    mc->caches = (CacheLine ***)malloc(num_cores * sizeof(CacheLine **));
+    mc->history = (LineMap *)malloc(num_cores * sizeof(LineMap));
+    mc->core_stats = (CoreStats *)calloc(num_cores, sizeof(CoreStats));
+    if (mc->caches == NULL || mc->history == NULL || mc->core_stats == NULL) {
+        fprintf(stderr, "Error: Failed to allocate multi-core state\n");
+        exit(1);
+    }
+    
+    for (int c = 0; c < num_cores; c++) {
+        init_cache(&mc->caches[c], config);
+        linemap_init(&mc->history[c], 1024);
+    }
+}
+
+/**
+ * Initialize an empty directory; sets == 0 makes an unbounded full map
+ */
+void init_directory(Directory *dir, int sets, int ways, int policy) {
+    memset(dir, 0, sizeof(*dir));
+    dir->sparse = sets > 0;
+    dir->sets = sets;
+    dir->ways = ways;
+    dir->policy = policy;
+    dir->rng = 12345;
+    
+    if (dir->sparse) {
+        dir->capacity = sets * ways;
+        dir->entries = (DirEntry *)calloc(dir->capacity, sizeof(DirEntry));
+    } else {
+        linemap_init(&dir->index, 1024);
+        dir->capacity = 1024;
+        dir->entries = (DirEntry *)malloc(dir->capacity * sizeof(DirEntry));
+    }
+    if (dir->entries == NULL) {
+        fprintf(stderr, "Error: Failed to allocate directory\n");
+        exit(1);
+    }
+}
+
+/**
+ * Find the directory entry for a line, or NULL if it is not tracked
+ */
+DirEntry *dir_find(Directory *dir, unsigned int line_addr) {
+    if (!dir->sparse) {
+        unsigned int *slot = linemap_find(&dir->index, line_addr);
+        return slot != NULL ? &dir->entries[*slot] : NULL;
+    }
+    
+    DirEntry *set = &dir->entries[(line_addr % dir->sets) * dir->ways];
+    for (int w = 0; w < dir->ways; w++) {
+        if (set[w].valid && set[w].line_addr == line_addr) {
+            set[w].lru = ++dir->clock;
+            return &set[w];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Find the directory entry for a line, allocating an empty one if needed
+ *
+ * When a sparse directory has to replace a valid entry, the old entry is
+ * copied to *evicted (evicted->valid is 0 otherwise) so the caller can
+ * invalidate the private copies it tracked.
+ */
+DirEntry *dir_lookup(Directory *dir, unsigned int line_addr, DirEntry *evicted) {
+    DirEntry *entry = dir_find(dir, line_addr);
+    
+    evicted->valid = 0;
+    dir->stats.lookups++;
+    if (entry != NULL) {
+        dir->stats.hits++;
+        return entry;
+    }
+    dir->stats.allocations++;
+    
+    if (!dir->sparse) {
+        if (dir->count == dir->capacity) {
+            dir->capacity *= 2;
+            dir->entries = (DirEntry *)realloc(dir->entries, dir->capacity * sizeof(DirEntry));
+            if (dir->entries == NULL) {
+                fprintf(stderr, "Error: Failed to allocate directory\n");
+                exit(1);
+            }
+        }
+        entry = &dir->entries[dir->count];
+        *linemap_insert(&dir->index, line_addr) = dir->count++;
+    } else {
+        DirEntry *set = &dir->entries[(line_addr % dir->sets) * dir->ways];
+        for (int w = 0; w < dir->ways && entry == NULL; w++) {
+            if (!set[w].valid) {
+                entry = &set[w];
+            }
+        }
+        
+        if (entry == NULL) {
+            if (dir->policy == DIR_RANDOM) {
+                dir->rng = dir->rng * 1103515245u + 12345u;
+                entry = &set[(dir->rng >> 16) % dir->ways];
+            } else {
+                entry = &set[0];
+                for (int w = 1; w < dir->ways; w++) {
+                    if (set[w].lru < entry->lru) {
+                        entry = &set[w];
+                    }
+                }
+            }
+            *evicted = *entry;
+            dir->stats.evictions++;
+        } else {
+            dir->count++;
+        }
+    }
+    
+    entry->sharers = 0;
+    entry->owner = -1;
+    entry->line_addr = line_addr;
+    entry->valid = 1;
+    entry->lru = ++dir->clock;
+    return entry;
+}
+
+/**
+ * Drop a core from an entry; sparse entries with no sharers are freed
+ */
+void dir_remove_sharer(Directory *dir, DirEntry *entry, int core) {
+    entry->sharers &= ~(1ULL << core);
+    if (entry->owner == core) {
+        entry->owner = -1;
+    }
+    if (dir->sparse && entry->sharers == 0) {
+        entry->valid = 0;
+        dir->count--;
+    }
+}
+
+/**
+ * Print directory geometry and statistics
+ */
+void print_directory_report(Directory *dir, MultiCore *mc) {
+    printf("\n");
+    printf("Directory\n");
+    printf("==============================\n");
+    if (dir->sparse) {
+        int private_lines = mc->num_cores * mc->config->num_sets * mc->config->associativity;
+        printf("Geometry:          %d sets, %d ways, %s\n", dir->sets, dir->ways,
+               dir->policy == DIR_RANDOM ? "random" : "LRU");
+        printf("Coverage:          %.2fx private lines\n",
+               (double)dir->capacity / private_lines);
+    } else {
+        printf("Geometry:          full map\n");
+    }
+    printf("Entries in use:    %d\n", dir->count);
+    printf("Lookups:           %d\n", dir->stats.lookups);
+    printf("Hits:              %d\n", dir->stats.hits);
+    printf("Allocations:       %d\n", dir->stats.allocations);
+    printf("Evictions:         %d\n", dir->stats.evictions);
+    printf("Back-invalidations: %d\n", dir->stats.back_invalidations);
+}
+
+/**
+ * Free directory memory
+ */
+void free_directory(Directory *dir) {
+    if (!dir->sparse) {
+        linemap_free(&dir->index);
+    }
+    free(dir->entries);
+}
+
+/**
+ * Invalidate the private copies tracked by an evicted directory entry
+ */
+void back_invalidate(MultiCore *mc, Directory *dir, DirEntry *evicted) {
+    CacheConfig *config = mc->config;
+    unsigned int index = evicted->line_addr & ((1 << config->index_bits) - 1);
+    unsigned int tag = evicted->line_addr >> config->index_bits;
+    
+    for (int c = 0; c < mc->num_cores; c++) {
+        if (!(evicted->sharers & (1ULL << c))) {
+            continue;
+        }
+        int way = find_way(mc->caches[c][index], config->associativity, tag);
+        if (way < 0) {
+            continue;
+        }
+        
+        CacheLine *line = &mc->caches[c][index][way];
+        if (line->state == STATE_M || line->state == STATE_O) {
+            mc->coherence.writebacks++;
+            mc->core_stats[c].stats.mem_writes++;
+        }
+        line->valid = 0;
+        line->state = STATE_I;
+        *linemap_insert(&mc->history[c], evicted->line_addr) = 3;
+        dir->stats.back_invalidations++;
+    }
+}
+
+/**
+ * Mask of the bytes an access touches within its cache line
+ */
+unsigned long long byte_mask(CacheConfig *config, unsigned int address, int size) {
+    unsigned int offset = address & (config->line_size - 1);
+    return ((1ULL << size) - 1) << offset;
+}
+
+/**
+ * Initialize an empty false-sharing detector
+ */
+void init_false_sharing(FalseSharing *fs) {
+    memset(fs, 0, sizeof(*fs));
+    linemap_init(&fs->index, 1024);
+}
+
+/**
+ * Merge a core's bytes into a sharing record (first SHARING_CORES cores)
+ */
+void add_sharing_core(SharingLine *sl, int core, unsigned long long bytes) {
+    for (int i = 0; i < sl->num_cores; i++) {
+        if (sl->core_ids[i] == core) {
+            sl->core_bytes[i] |= bytes;
+            return;
+        }
+    }
+    if (sl->num_cores < SHARING_CORES) {
+        sl->core_ids[sl->num_cores] = core;
+        sl->core_bytes[sl->num_cores++] = bytes;
+    }
+}
+
+/**
+ * Record a write invalidation; it is false sharing when the writer's bytes
+ * and the bytes the victim copy used since its fill do not overlap
+ */
+void record_invalidation(FalseSharing *fs, unsigned int line_addr, int writer,
+                         int victim, unsigned long long write_bytes,
+                         unsigned long long victim_bytes) {
+    unsigned int *slot = linemap_find(&fs->index, line_addr);
+    
+    if (slot == NULL) {
+        if (fs->count == fs->capacity) {
+            fs->capacity = fs->capacity ? 2 * fs->capacity : 1024;
+            fs->lines = (SharingLine *)realloc(fs->lines, fs->capacity * sizeof(SharingLine));
+            if (fs->lines == NULL) {
+                fprintf(stderr, "Error: Failed to allocate false-sharing records\n");
+                exit(1);
+            }
+        }
+        memset(&fs->lines[fs->count], 0, sizeof(SharingLine));
+        fs->lines[fs->count].line_addr = line_addr;
+        slot = linemap_insert(&fs->index, line_addr);
+        *slot = fs->count++;
+    }
+    
+    SharingLine *sl = &fs->lines[*slot];
+    sl->invalidations++;
+    fs->invalidations++;
+    if ((write_bytes & victim_bytes) == 0) {
+        sl->false_invalidations++;
+        fs->false_invalidations++;
+        add_sharing_core(sl, writer, write_bytes);
+        add_sharing_core(sl, victim, victim_bytes);
+    }
+}
+
+/**
+ * Order sharing records worst first
+ */
+int compare_sharing(const void *a, const void *b) {
+    const SharingLine *x = (const SharingLine *)a;
+    const SharingLine *y = (const SharingLine *)b;
+    
+    if (x->false_invalidations != y->false_invalidations) {
+        return y->false_invalidations - x->false_invalidations;
+    }
+    if (x->invalidations != y->invalidations) {
+        return y->invalidations - x->invalidations;
+    }
+    return x->line_addr < y->line_addr ? -1 : (x->line_addr > y->line_addr);
+}
+
+/**
+ * Order symbols by start address
+ */
+int compare_symbols(const void *a, const void *b) {
+    const Symbol *x = (const Symbol *)a;
+    const Symbol *y = (const Symbol *)b;
+    return x->start < y->start ? -1 : (x->start > y->start);
+}
+
+/**
+ * Load a symbol map: nm -S lines ("start size type name") or
+ * "start size name", with hexadecimal start and size
+ */
+int load_symbols(SymbolMap *map, const char *path) {
+    FILE *fp = fopen(path, "r");
+    char line[512];
+    int capacity = 0;
+    
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Cannot open symbol map %s\n", path);
+        return 0;
+    }
+    
+    map->symbols = NULL;
+    map->count = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        Symbol sym;
+        char type;
+        if (sscanf(line, "%llx %llx %c %63s", &sym.start, &sym.size, &type, sym.name) != 4 &&
+            sscanf(line, "%llx %llx %63s", &sym.start, &sym.size, sym.name) != 3) {
+            continue;
+        }
+        
+        if (map->count == capacity) {
+            capacity = capacity ? 2 * capacity : 256;
+            map->symbols = (Symbol *)realloc(map->symbols, capacity * sizeof(Symbol));
+            if (map->symbols == NULL) {
+                fprintf(stderr, "Error: Failed to allocate symbol map\n");
+                exit(1);
+            }
+        }
+        map->symbols[map->count++] = sym;
+    }
+    fclose(fp);
+    
+    qsort(map->symbols, map->count, sizeof(Symbol), compare_symbols);
+    return 1;
+}
+
+/**
+ * Find the symbol containing an address, or NULL
+ */
+Symbol *find_symbol(SymbolMap *map, unsigned long long address) {
+    int lo = 0;
+    int hi = map->count - 1;
+    Symbol *best = NULL;
+    
+    // Last symbol starting at or below the address
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (map->symbols[mid].start <= address) {
+            best = &map->symbols[mid];
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    
+    if (best != NULL && address < best->start + (best->size ? best->size : 1)) {
+        return best;
+    }
+    return NULL;
+}
+
+/**
+ * Format a byte mask as ranges of offsets, e.g. "0-3,8-15"
+ */
+void format_byte_ranges(unsigned long long mask, char *buf, size_t len) {
+    size_t used = 0;
+    
+    buf[0] = '\0';
+    for (int i = 0; i < 64 && used < len; i++) {
+        if (!(mask & (1ULL << i))) {
+            continue;
+        }
+        int j = i;
+        while (j + 1 < 64 && (mask & (1ULL << (j + 1)))) {
+            j++;
+        }
+        used += snprintf(buf + used, len - used, used ? ",%d-%d" : "%d-%d", i, j);
+        i = j;
+    }
+}
+
+/**
+ * Index of the lowest set bit of a nonzero mask
+ */
+int lowest_bit(unsigned long long mask) {
+    int bit = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+}
+
+/**
+ * Print the lines with the most false-sharing invalidations
+ */
+void print_false_sharing_report(FalseSharing *fs, CacheConfig *config,
+                                SymbolMap *symbols, int top) {
+    char ranges[96];
+    
+    qsort(fs->lines, fs->count, sizeof(SharingLine), compare_sharing);
+    
+    printf("\n");
+    printf("False Sharing\n");
+    printf("==============================\n");
+    printf("Write invalidations: %d\n", fs->invalidations);
+    printf("False sharing:       %d\n", fs->false_invalidations);
+    printf("\n");
+    printf("Line     Inval  False  Core bytes [symbol]\n");
+    for (int i = 0; i < fs->count && i < top; i++) {
+        SharingLine *sl = &fs->lines[i];
+        if (sl->false_invalidations == 0) {
+            break;
+        }
+        
+        unsigned long long base = (unsigned long long)sl->line_addr << config->offset_bits;
+        printf("%08llx %-6d %-6d", base, sl->invalidations, sl->false_invalidations);
+        for (int c = 0; c < sl->num_cores; c++) {
+            format_byte_ranges(sl->core_bytes[c], ranges, sizeof(ranges));
+            printf(" c%d:%s", sl->core_ids[c], ranges);
+            if (symbols != NULL) {
+                Symbol *sym = find_symbol(symbols, base + lowest_bit(sl->core_bytes[c]));
+                printf(" [%s]", sym ? sym->name : "?");
+            }
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * Free false-sharing detector memory
+ */
+void free_false_sharing(FalseSharing *fs) {
+    linemap_free(&fs->index);
+    free(fs->lines);
+}
+
+/**
+ * Invalidate a core's copy of a line because another core (writer) writes
+ * the bytes in write_bytes
+ */
+void invalidate_copy(MultiCore *mc, int core, CacheLine *line, unsigned int line_addr,
+                     int writer, unsigned long long write_bytes) {
+    if (mc->sharing != NULL) {
+        record_invalidation(mc->sharing, line_addr, writer, core, write_bytes, line->touched);
+    }
+    line->valid = 0;
+    line->state = STATE_I;
+    *linemap_insert(&mc->history[core], line_addr) = 2;
+    mc->coherence.invalidations++;
+}
+
+/**
+ * Initialize an interconnect joining num_cores cores and a memory controller
+ */
+void init_interconnect(Interconnect *net, int topology, int num_cores,
+                       int hop_latency, int bandwidth) {
+    memset(net, 0, sizeof(*net));
+    net->topology = topology;
+    net->num_nodes = num_cores + 1;
+    net->hop_latency = hop_latency;
+    net->bandwidth = bandwidth;
+    
+    net->mesh_cols = 1;
+    while (net->mesh_cols * net->mesh_cols < net->num_nodes) {
+        net->mesh_cols++;
+    }
+    
+    if (topology == NET_BUS) {
+        net->num_links = 1;
+    } else if (topology == NET_RING) {
+        net->num_links = 2 * net->num_nodes;   // Clockwise, counter-clockwise
+    } else {
+        // East, west, south, north; routers in an incomplete last row still forward
+        net->num_links = 4 * net->mesh_cols * net->mesh_cols;
+    }
+    
+    net->schedule = (LinkSchedule *)calloc(net->num_links, sizeof(LinkSchedule));
+    net->busy_cycles = (unsigned long long *)calloc(net->num_links, sizeof(unsigned long long));
+    net->link_delay = (unsigned long long *)calloc(net->num_links, sizeof(unsigned long long));
+    net->link_messages = (int *)calloc(net->num_links, sizeof(int));
+    if (net->schedule == NULL || net->busy_cycles == NULL ||
+        net->link_delay == NULL || net->link_messages == NULL) {
+        fprintf(stderr, "Error: Failed to allocate interconnect\n");
+        exit(1);
+    }
+}
+
+/**
+ * Choose the next link and node on the route from node to dst
+ *
+ * Rings take the shorter direction; meshes use dimension-order (XY) routing.
+ */
+int next_hop(Interconnect *net, int node, int dst, int *next) {
+    if (net->topology == NET_BUS) {
+        *next = dst;
+        return 0;
+    }
+    
+    if (net->topology == NET_RING) {
+        int n = net->num_nodes;
+        int forward = (dst - node + n) % n;
+        if (forward <= n - forward) {
+            *next = (node + 1) % n;
+            return 2 * node;
+        }
+        *next = (node - 1 + n) % n;
+        return 2 * node + 1;
+    }
+    
+    int x = node % net->mesh_cols;
+    int y = node / net->mesh_cols;
+    int dx = dst % net->mesh_cols;
+    if (dx > x) {
+        *next = node + 1;
+        return 4 * node;
+    }
+    if (dx < x) {
+        *next = node - 1;
+        return 4 * node + 1;
+    }
+    if (dst / net->mesh_cols > y) {
+        *next = node + net->mesh_cols;
+        return 4 * node + 2;
+    }
+    *next = node - net->mesh_cols;
+    return 4 * node + 3;
+}
+
+/**
+ * Reserve occupancy cycles on a link at or after time; returns the start
+ *
+ * The message takes the first gap that fits, so a core whose clock lags
+ * behind others is not queued behind reservations made in its future.
+ * Intervals that end by the horizon can no longer overlap any message and
+ * are dropped.
+ */
+unsigned long long link_reserve(LinkSchedule *ls, unsigned long long time, int occupancy,
+                                unsigned long long horizon) {
+    while (ls->first < ls->count && ls->end[ls->first] <= horizon) {
+        ls->first++;
+    }
+    if (ls->first > 0 && 2 * ls->first >= ls->count) {
+        ls->count -= ls->first;
+        memmove(ls->start, &ls->start[ls->first], ls->count * sizeof(*ls->start));
+        memmove(ls->end, &ls->end[ls->first], ls->count * sizeof(*ls->end));
+        ls->first = 0;
+    }
+    
+    // First interval still busy at time, then skip intervals the message overlaps
+    int lo = ls->first;
+    int hi = ls->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (ls->end[mid] > time) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    int i = lo;
+    unsigned long long start = time;
+    while (i < ls->count && ls->start[i] < start + occupancy) {
+        if (ls->end[i] > start) {
+            start = ls->end[i];
+        }
+        i++;
+    }
+    unsigned long long stop = start + occupancy;
+    
+    int join_prev = i > ls->first && ls->end[i - 1] == start;
+    int join_next = i < ls->count && ls->start[i] == stop;
+    if (join_prev && join_next) {
+        ls->end[i - 1] = ls->end[i];
+        ls->count--;
+        memmove(&ls->start[i], &ls->start[i + 1], (ls->count - i) * sizeof(*ls->start));
+        memmove(&ls->end[i], &ls->end[i + 1], (ls->count - i) * sizeof(*ls->end));
+    } else if (join_prev) {
+        ls->end[i - 1] = stop;
+    } else if (join_next) {
+        ls->start[i] = start;
+    } else {
+        if (ls->count == ls->capacity) {
+            ls->capacity = ls->capacity > 0 ? 2 * ls->capacity : 16;
+            ls->start = (unsigned long long *)realloc(ls->start,
+                                                      ls->capacity * sizeof(*ls->start));
+            ls->end = (unsigned long long *)realloc(ls->end, ls->capacity * sizeof(*ls->end));
+            if (ls->start == NULL || ls->end == NULL) {
+                fprintf(stderr, "Error: Failed to allocate link schedule\n");
+                exit(1);
+            }
+        }
+        memmove(&ls->start[i + 1], &ls->start[i], (ls->count - i) * sizeof(*ls->start));
+        memmove(&ls->end[i + 1], &ls->end[i], (ls->count - i) * sizeof(*ls->end));
+        ls->start[i] = start;
+        ls->end[i] = stop;
+        ls->count++;
+    }
+    return start;
+}
+
+/**
+ * Send a message injected at cycle time; returns its arrival cycle
+ *
+ * Each link carries one message at a time: a message waits for the first
+ * free slot, occupies the link for bytes / bandwidth cycles, then takes
+ * hop_latency cycles to reach the next node.
+ */
+unsigned long long net_send(Interconnect *net, int src, int dst, int bytes,
+                            unsigned long long time) {
+    unsigned long long delay = 0;
+    int occupancy = (bytes + net->bandwidth - 1) / net->bandwidth;
+    int node = src;
+    
+    if (src == dst) {
+        return time;
+    }
+    
+    while (node != dst) {
+        int next;
+        int link = next_hop(net, node, dst, &next);
+        unsigned long long start = link_reserve(&net->schedule[link], time, occupancy,
+                                                net->horizon);
+        
+        delay += start - time;
+        net->link_delay[link] += start - time;
+        net->busy_cycles[link] += occupancy;
+        net->link_messages[link]++;
+        time = start + occupancy + net->hop_latency;
+        node = next;
+    }
+    
+    int bucket = 0;
+    while (bucket < DELAY_BUCKETS - 1 && (1ULL << bucket) <= delay) {
+        bucket++;
+    }
+    net->delay_hist[bucket]++;
+    net->messages++;
+    net->queue_cycles += delay;
+    return time;
+}
+
+/**
+ * Print elapsed time, queueing delay and per-link utilization
+ *
+ * Links are numbered per node: ring links are 2*node (clockwise) and
+ * 2*node+1; mesh links are 4*node + east/west/south/north.
+ */
+void print_interconnect_report(Interconnect *net, MultiCore *mc) {
+    static const char *names[] = { "none", "bus", "ring", "mesh" };
+    unsigned long long elapsed = 1;
+    unsigned long long accesses = 0;
+    unsigned long long total_cycles = 0;
+    
+    for (int c = 0; c < mc->num_cores; c++) {
+        if (mc->cycles[c] > elapsed) {
+            elapsed = mc->cycles[c];
+        }
+        accesses += mc->core_stats[c].stats.hits + mc->core_stats[c].stats.misses;
+        if (mc->first_cycle[c] != ~0ULL) {
+            total_cycles += mc->cycles[c] - mc->first_cycle[c];
+        }
+    }
+    
+    printf("\n");
+    printf("Interconnect (%s, %d nodes)\n", names[net->topology], net->num_nodes);
+    printf("==============================\n");
+    printf("Elapsed cycles:    %llu\n", elapsed);
+    printf("Average access:    %.2f cycles\n",
+           accesses > 0 ? (double)total_cycles / accesses : 0.0);
+    printf("Messages:          %llu\n", net->messages);
+    printf("Avg queue delay:   %.2f cycles\n",
+           net->messages > 0 ? (double)net->queue_cycles / net->messages : 0.0);
+    
+    printf("\nQueue delay (cycles)  Messages\n");
+    for (int b = 0; b < DELAY_BUCKETS; b++) {
+        if (net->delay_hist[b] == 0) {
+            continue;
+        }
+        if (b == 0) {
+            printf("0                     %llu\n", net->delay_hist[b]);
+        } else {
+            char range[32];
+            snprintf(range, sizeof(range), "%llu-%llu", 1ULL << (b - 1), (1ULL << b) - 1);
+            printf("%-21s %llu\n", range, net->delay_hist[b]);
+        }
+    }
+    
+    printf("\nLink  Utilization  Messages   Avg delay\n");
+    for (int l = 0; l < net->num_links; l++) {
+        if (net->link_messages[l] == 0) {
+            continue;
+        }
+        printf("%-5d %6.2f%%      %-10d %.2f\n", l, 100.0 * net->busy_cycles[l] / elapsed,
+               net->link_messages[l], (double)net->link_delay[l] / net->link_messages[l]);
+    }
+}
+
+/**
+ * Free interconnect memory
+ */
+void free_interconnect(Interconnect *net) {
+    for (int l = 0; l < net->num_links; l++) {
+        free(net->schedule[l].start);
+        free(net->schedule[l].end);
+    }
+    free(net->schedule);
+    free(net->busy_cycles);
+    free(net->link_delay);
+    free(net->link_messages);
+}
+
+/**
+ * Cores other than core that may hold a line: the snoop filter's sharers,
+ * or every core when snooping is broadcast
+ */
+unsigned long long snoop_targets(MultiCore *mc, int core, unsigned int line_addr) {
+    unsigned long long others = ~(1ULL << core);
+    
+    if (mc->filter != NULL) {
+        DirEntry *entry = dir_find(mc->filter, line_addr);
+        return entry != NULL ? entry->sharers & others : 0;
+    }
+    
+    return (mc->num_cores == 64 ? ~0ULL : (1ULL << mc->num_cores) - 1) & others;
+}
+
+/**
+ * Start a core's clock at its first access and advance the horizon
+ *
+ * The horizon is the slowest started core's clock; every later message is
+ * injected at or after it. A core that first appears later in the trace
+ * starts at the horizon rather than at cycle 0.
+ */
+void advance_horizon(MultiCore *mc, int core) {
+    unsigned long long horizon = ~0ULL;
+    
+    for (int c = 0; c < mc->num_cores; c++) {
+        if (mc->first_cycle[c] != ~0ULL && mc->cycles[c] < horizon) {
+            horizon = mc->cycles[c];
+        }
+    }
+    if (horizon == ~0ULL) {
+        horizon = 0;
+    }
+    if (mc->first_cycle[core] == ~0ULL) {
+        mc->cycles[core] = horizon;
+        mc->first_cycle[core] = horizon;
+    }
+    mc->net->horizon = horizon;
+}
+
+/**
+ * Simulate an access by one core in multi-core mode
+ *
+ * Private caches are write-back and write-allocate. Misses snoop the other
+ * cores (all of them, or the sharers a snoop filter lists): dirty or
+ * exclusive holders supply the line cache-to-cache, and writes invalidate all
+ * other copies. Returns 1 on a hit, 0 on a miss and -1 for an unknown access
+ * type; *miss_class receives the miss classification.
+ */
+int access_coherent(MultiCore *mc, int core, char access_type,
+                    unsigned int address, int size, int *miss_class) {
+    CacheConfig *config = mc->config;
+    unsigned long long bytes = byte_mask(config, address, size);
+    int assoc = config->associativity;
+    unsigned int line_addr = address >> config->offset_bits;
+    unsigned int index = line_addr & ((1 << config->index_bits) - 1);
+    unsigned int tag = line_addr >> config->index_bits;
+    CoreStats *cs = &mc->core_stats[core];
+    CacheLine *set = mc->caches[core][index];
+    Interconnect *net = mc->net;
+    int home = mc->num_cores;   // Memory controller node
+    int data_bytes = config->line_size + CONTROL_BYTES;
+    unsigned long long now;
+    unsigned long long done;
+    int is_write;
+    
+    if (access_type == 'W' || access_type == 'w') {
+        is_write = 1;
+    } else if (access_type == 'R' || access_type == 'r') {
+        is_write = 0;
+    } else {
+        return -1;
+    }
+    
+    if (net != NULL) {
+        advance_horizon(mc, core);
+    }
+    now = net != NULL ? mc->cycles[core] + mc->hit_latency : 0;
+    done = now;
+    
+    *miss_class = MISS_NONE;
+    int way = find_way(set, assoc, tag);
+    
+    if (way >= 0) {
+        cs->stats.hits++;
+        if (is_write) {
+            if (set[way].state == STATE_S || set[way].state == STATE_O) {
+                // Upgrade: invalidate every other copy before writing
+                unsigned long long targets = snoop_targets(mc, core, line_addr);
+                unsigned long long request = net != NULL ?
+                    net_send(net, core, home, CONTROL_BYTES, now) : 0;
+                mc->coherence.upgrades++;
+                for (int c = 0; c < mc->num_cores; c++) {
+                    int w = (targets & (1ULL << c)) ?
+                            find_way(mc->caches[c][index], assoc, tag) : -1;
+                    if (w >= 0) {
+                        invalidate_copy(mc, c, &mc->caches[c][index][w], line_addr,
+                                        core, bytes);
+                        if (net != NULL) {
+                            // Invalidation from home, acknowledgement to requester
+                            unsigned long long ack = net_send(net, c, core, CONTROL_BYTES,
+                                net_send(net, home, c, CONTROL_BYTES, request));
+                            done = ack > done ? ack : done;
+                        }
+                    }
+                }
+                if (mc->filter != NULL) {
+                    dir_find(mc->filter, line_addr)->sharers = 1ULL << core;
+                }
+            }
+            set[way].state = STATE_M;
+        }
+        set[way].touched |= bytes;
+        update_lru(set, assoc, way);
+        if (net != NULL) {
+            mc->cycles[core] = done;
+        }
+        return 1;
+    }
+    
+    // Classify the miss from this core's history of the line
+    cs->stats.misses++;
+    unsigned int *seen = linemap_find(&mc->history[core], line_addr);
+    if (seen == NULL) {
+        *miss_class = MISS_COLD;
+        cs->cold_misses++;
+    } else if (*seen == 2) {
+        *miss_class = MISS_COHERENCE;
+        cs->coherence_misses++;
+    } else if (*seen == 3) {
+        *miss_class = MISS_DIRECTORY;
+        cs->directory_misses++;
+    } else {
+        *miss_class = MISS_CAPACITY;
+        cs->capacity_misses++;
+    }
+    
+    // Snoop the other cores
+    unsigned long long targets = snoop_targets(mc, core, line_addr);
+    unsigned long long request = net != NULL ?
+        net_send(net, core, home, CONTROL_BYTES, now) : 0;
+    int supplied = 0;
+    int supplier = home;
+    int shared = 0;
+    for (int c = 0; c < mc->num_cores; c++) {
+        int w = (targets & (1ULL << c)) ? find_way(mc->caches[c][index], assoc, tag) : -1;
+        if (w < 0) {
+            continue;
+        }
+        
+        CacheLine *remote = &mc->caches[c][index][w];
+        if (remote->state != STATE_S && !supplied) {
+            supplied = 1;
+            supplier = c;
+        }
+        
+        if (is_write) {
+            invalidate_copy(mc, c, remote, line_addr, core, bytes);
+            if (net != NULL && c != supplier) {
+                unsigned long long ack = net_send(net, c, core, CONTROL_BYTES,
+                    net_send(net, home, c, CONTROL_BYTES, request));
+                done = ack > done ? ack : done;
+            }
+        } else if (remote->state == STATE_M && mc->protocol == PROTOCOL_MESI) {
+            // MESI has no owned state: dirty data goes back to memory
+            mc->coherence.writebacks++;
+            cs->stats.mem_writes++;
+            remote->state = STATE_S;
+            if (net != NULL) {
+                net_send(net, c, home, data_bytes, request);
+            }
+        } else if (remote->state == STATE_M) {
+            remote->state = STATE_O;
+        } else if (remote->state == STATE_E) {
+            remote->state = STATE_S;
+        }
+        shared = 1;
+    }
+    
+    if (supplied) {
+        mc->coherence.c2c_transfers++;
+    } else {
+        cs->stats.mem_reads++;
+    }
+    
+    if (net != NULL) {
+        // Data from the supplying cache (forwarded by home) or from memory
+        unsigned long long ready = supplied ?
+            net_send(net, supplier, core, data_bytes,
+                     net_send(net, home, supplier, CONTROL_BYTES, request)) :
+            net_send(net, home, core, data_bytes, request + mc->mem_latency);
+        done = ready > done ? ready : done;
+    }
+    
+    // Track the new copy; a full snoop filter evicts another line's entry
+    if (mc->filter != NULL) {
+        DirEntry evicted;
+        DirEntry *entry = dir_lookup(mc->filter, line_addr, &evicted);
+        if (evicted.valid) {
+            back_invalidate(mc, mc->filter, &evicted);
+        }
+        entry->sharers = is_write ? 1ULL << core : entry->sharers | (1ULL << core);
+    }
+    
+    // Replace the LRU line, writing it back if dirty
+    int victim = find_lru_victim(set, assoc, (1u << assoc) - 1);
+    if (set[victim].valid) {
+        if (set[victim].state == STATE_M || set[victim].state == STATE_O) {
+            mc->coherence.writebacks++;
+            cs->stats.mem_writes++;
+            if (net != NULL) {
+                net_send(net, core, home, data_bytes, now);  // Posted writeback
+            }
+        }
+        if (mc->filter != NULL) {
+            unsigned int victim_line = (set[victim].tag << config->index_bits) | index;
+            DirEntry *entry = dir_find(mc->filter, victim_line);
+            if (entry != NULL) {
+                dir_remove_sharer(mc->filter, entry, core);
+            }
+        }
+    }
+    
+    set[victim].valid = 1;
+    set[victim].tag = tag;
+    set[victim].state = is_write ? STATE_M : (shared ? STATE_S : STATE_E);
+    set[victim].touched = bytes;
+    update_lru(set, assoc, victim);
+    *linemap_insert(&mc->history[core], line_addr) = 1;
+    
+    if (net != NULL) {
+        mc->cycles[core] = done;
+    }
+    return 0;
+}
+
+/**
+ * Simulate and print one multi-core access
+ */
+void simulate_core_access(MultiCore *mc, int core, char access_type,
+                          unsigned int address, int size, int quiet) {
+    static const char *class_names[] = { "-", "cold", "capacity", "coherence", "directory" };
+    CacheConfig *config = mc->config;
+    CacheStats *cs = &mc->core_stats[core].stats;
+    int refs_before = cs->mem_reads + cs->mem_writes;
+    int miss_class;
+    
+    int hit = access_coherent(mc, core, access_type, address, size, &miss_class);
+    if (hit < 0 || quiet) {
+        return;
+    }
+    
+    unsigned int offset = address & ((1 << config->offset_bits) - 1);
+    unsigned int index = (address >> config->offset_bits) & ((1 << config->index_bits) - 1);
+    unsigned int tag = address >> (config->offset_bits + config->index_bits);
+    printf("%c %08x %x %x %x %s %d %d %s\n",
+           access_type, address, tag, index, offset, hit ? "hit " : "miss",
+           cs->mem_reads + cs->mem_writes - refs_before, core, class_names[miss_class]);
+}
+
+/**
+ * Print per-core statistics and coherence traffic
+ */
+void print_multicore_report(MultiCore *mc) {
+    printf("\n");
+    printf("Per-Core Statistics\n");
+    printf("==============================\n");
+    printf("Core Accesses   Hits       Cold       Cap/Conf   Coherence  Directory\n");
+    for (int c = 0; c < mc->num_cores; c++) {
+        CoreStats *cs = &mc->core_stats[c];
+        printf("%-4d %-10d %-10d %-10d %-10d %-10d %d\n", c,
+               cs->stats.hits + cs->stats.misses, cs->stats.hits,
+               cs->cold_misses, cs->capacity_misses, cs->coherence_misses,
+               cs->directory_misses);
+    }
+    
+    printf("\n");
+    printf("Coherence Traffic (%s)\n", mc->protocol == PROTOCOL_MOESI ? "MOESI" : "MESI");
+    printf("==============================\n");
+    printf("Invalidations:     %d\n", mc->coherence.invalidations);
+    printf("Upgrades:          %d\n", mc->coherence.upgrades);
+    printf("Cache-to-cache:    %d\n", mc->coherence.c2c_transfers);
+    printf("Writebacks:        %d\n", mc->coherence.writebacks);
+}
+
+/**
+ * Free multi-core state
+ */
+void free_multicore(MultiCore *mc) {
+    for (int c = 0; c < mc->num_cores; c++) {
+        free_cache(mc->caches[c], mc->config->num_sets);
+        linemap_free(&mc->history[c]);
+    }
+    free(mc->caches);
+    free(mc->history);
+    free(mc->core_stats);
+}
+
+/**
+ * Initialize a request queue holding at least capacity requests
+ */
+void init_queue(RequestQueue *q, unsigned int capacity) {
+    unsigned int size = 16;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    q->slots = (CoherenceRequest *)malloc(size * sizeof(CoherenceRequest));
+    if (q->slots == NULL) {
+        fprintf(stderr, "Error: Failed to allocate request queue\n");
+        exit(1);
+    }
+    q->mask = size - 1;
+    q->head = 0;
+    q->tail = 0;
+}
+
+/**
+ * Append a request (producer side); the queue is sized so it never fills
+ */
+void queue_push(RequestQueue *q, unsigned int line_addr, int type, unsigned int time,
+                unsigned long long bytes) {
+    unsigned int tail = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    CoherenceRequest *req = &q->slots[tail & q->mask];
+    req->line_addr = line_addr;
+    req->type = type;
+    req->time = time;
+    req->bytes = bytes;
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Peek at the oldest request (consumer side), or NULL if empty
+ */
+CoherenceRequest *queue_peek(RequestQueue *q) {
+    unsigned int tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    if (q->head == tail) {
+        return NULL;
+    }
+    return &q->slots[q->head & q->mask];
+}
+
+/**
+ * Drop the oldest request (consumer side)
+ */
+void queue_pop(RequestQueue *q) {
+    __atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Find a core's private copy of a line, or NULL
+ */
+CacheLine *find_private_line(MultiCore *mc, int core, unsigned int line_addr) {
+    CacheConfig *config = mc->config;
+    unsigned int index = line_addr & ((1 << config->index_bits) - 1);
+    int way = find_way(mc->caches[core][index], config->associativity,
+                       line_addr >> config->index_bits);
+    return way >= 0 ? &mc->caches[core][index][way] : NULL;
+}
+
+/**
+ * Simulate one access against a core's private cache (parallel phase)
+ *
+ * Misses fill immediately with a provisional state and post a request to
+ * the core's queue; the directory settles the final state and invalidates
+ * other copies when the quantum ends.
+ */
+void access_private(ParallelSim *sim, int core, CoreStats *cs,
+                    TraceRecord *rec, unsigned int time) {
+    MultiCore *mc = sim->mc;
+    CacheConfig *config = mc->config;
+    int assoc = config->associativity;
+    unsigned int line_addr = rec->address >> config->offset_bits;
+    unsigned int index = line_addr & ((1 << config->index_bits) - 1);
+    unsigned int tag = line_addr >> config->index_bits;
+    CacheLine *set = mc->caches[core][index];
+    RequestQueue *q = &sim->queues[core];
+    unsigned long long bytes = byte_mask(config, rec->address, rec->size);
+    int is_write;
+    
+    if (rec->type == 'W' || rec->type == 'w') {
+        is_write = 1;
+    } else if (rec->type == 'R' || rec->type == 'r') {
+        is_write = 0;
+    } else {
+        return;
+    }
+    
+    int way = find_way(set, assoc, tag);
+    if (way >= 0) {
+        cs->stats.hits++;
+        if (is_write) {
+            if (set[way].state == STATE_S || set[way].state == STATE_O) {
+                queue_push(q, line_addr, REQ_UPGRADE, time, bytes);
+            }
+            set[way].state = STATE_M;
+        }
+        set[way].touched |= bytes;
+        update_lru(set, assoc, way);
+        return;
+    }
+    
+    cs->stats.misses++;
+    unsigned int *seen = linemap_find(&mc->history[core], line_addr);
+    if (seen == NULL) {
+        cs->cold_misses++;
+    } else if (*seen == 2) {
+        cs->coherence_misses++;
+    } else if (*seen == 3) {
+        cs->directory_misses++;
+    } else {
+        cs->capacity_misses++;
+    }
+    
+    int victim = find_lru_victim(set, assoc, (1u << assoc) - 1);
+    if (set[victim].valid) {
+        int dirty = set[victim].state == STATE_M || set[victim].state == STATE_O;
+        queue_push(q, (set[victim].tag << config->index_bits) | index,
+                   dirty ? REQ_WRITEBACK : REQ_EVICT, time, 0);
+    }
+    
+    set[victim].valid = 1;
+    set[victim].tag = tag;
+    set[victim].state = is_write ? STATE_M : STATE_E;
+    set[victim].touched = bytes;
+    update_lru(set, assoc, victim);
+    *linemap_insert(&mc->history[core], line_addr) = 1;
+    queue_push(q, line_addr, is_write ? REQ_WRITE : REQ_READ, time, bytes);
+}
+
+/**
+ * Run one core's share of the current quantum
+ */
+void run_core_quantum(ParallelSim *sim, int core) {
+    CoreTrace *trace = &sim->traces[core];
+    int begin = sim->current_quantum * sim->quantum;
+    int end = begin + sim->quantum < trace->count ? begin + sim->quantum : trace->count;
+    
+    // Accumulate locally so cores on different threads don't share stat lines
+    CoreStats cs = sim->mc->core_stats[core];
+    for (int i = begin; i < end; i++) {
+        access_private(sim, core, &cs, &trace->records[i], (unsigned int)i);
+    }
+    sim->mc->core_stats[core] = cs;
+}
+
+/**
+ * Worker thread: simulate cores worker, worker + T, ... every quantum
+ */
+void *parallel_worker(void *arg) {
+    WorkerArg *wa = (WorkerArg *)arg;
+    ParallelSim *sim = wa->sim;
+    
+    for (;;) {
+        pthread_barrier_wait(&sim->start_barrier);
+        if (sim->done) {
+            break;
+        }
+        for (int c = wa->worker; c < sim->mc->num_cores; c += sim->num_threads) {
+            run_core_quantum(sim, c);
+        }
+        pthread_barrier_wait(&sim->finish_barrier);
+    }
+    
+    return NULL;
+}
+
+/**
+ * Invalidate every private copy of a line except the requester's
+ *
+ * Returns 1 if a dirty copy supplied the data.
+ */
+int dir_invalidate_others(ParallelSim *sim, DirEntry *entry, int core,
+                          unsigned int line_addr, unsigned long long bytes) {
+    MultiCore *mc = sim->mc;
+    int supplied = 0;
+    
+    for (int c = 0; c < mc->num_cores; c++) {
+        if (c == core || !(entry->sharers & (1ULL << c))) {
+            continue;
+        }
+        CacheLine *remote = find_private_line(mc, c, line_addr);
+        if (remote != NULL) {
+            if (remote->state == STATE_M || remote->state == STATE_O) {
+                supplied = 1;
+            }
+            invalidate_copy(mc, c, remote, line_addr, core, bytes);
+        }
+    }
+    
+    entry->sharers &= 1ULL << core;
+    entry->owner = -1;
+    return supplied;
+}
+
+/**
+ * Fetch a line for a core from the LLC or memory
+ */
+void fetch_line(ParallelSim *sim, int core, unsigned int line_addr) {
+    CacheStats *cs = &sim->mc->core_stats[core].stats;
+    
+    if (sim->has_llc) {
+        int hit = access_cache(sim->llc, &sim->llc_config, 'R',
+                               line_addr << sim->llc_config.offset_bits,
+                               (1u << sim->llc_config.associativity) - 1,
+                               core, NULL, &sim->llc_stats);
+        if (hit) {
+            return;
+        }
+    }
+    cs->mem_reads++;
+}
+
+/**
+ * Apply one queued request at the directory (serial phase)
+ */
+void process_request(ParallelSim *sim, int core, CoherenceRequest *req) {
+    MultiCore *mc = sim->mc;
+    CacheStats *cs = &mc->core_stats[core].stats;
+    unsigned long long bit = 1ULL << core;
+    CacheLine *mine = find_private_line(mc, core, req->line_addr);
+    DirEntry *entry;
+    DirEntry evicted;
+    
+    if (req->type == REQ_EVICT || req->type == REQ_WRITEBACK) {
+        entry = dir_find(&sim->dir, req->line_addr);
+    } else {
+        entry = dir_lookup(&sim->dir, req->line_addr, &evicted);
+        if (evicted.valid) {
+            back_invalidate(mc, &sim->dir, &evicted);
+            mine = find_private_line(mc, core, req->line_addr);
+        }
+    }
+    
+    switch (req->type) {
+    case REQ_READ: {
+        int supplied = 0;
+        if (entry->owner >= 0 && entry->owner != core) {
+            CacheLine *remote = find_private_line(mc, entry->owner, req->line_addr);
+            if (remote != NULL) {
+                supplied = 1;
+                if (remote->state == STATE_M && mc->protocol == PROTOCOL_MESI) {
+                    mc->coherence.writebacks++;
+                    cs->mem_writes++;
+                    remote->state = STATE_S;
+                    entry->owner = -1;
+                } else if (remote->state == STATE_M || remote->state == STATE_O) {
+                    remote->state = STATE_O;
+                } else {
+                    remote->state = STATE_S;
+                    entry->owner = -1;
+                }
+            }
+        }
+        
+        if (supplied) {
+            mc->coherence.c2c_transfers++;
+        } else {
+            fetch_line(sim, core, req->line_addr);
+        }
+        
+        int shared = (entry->sharers & ~bit) != 0;
+        entry->sharers |= bit;
+        if (mine != NULL && mine->state == STATE_M && shared) {
+            // Written later in the quantum while other copies existed
+            mc->coherence.upgrades++;
+            dir_invalidate_others(sim, entry, core, req->line_addr, mine->touched);
+            entry->owner = core;
+        } else if (mine != NULL && mine->state != STATE_M) {
+            mine->state = shared ? STATE_S : STATE_E;
+            if (!shared) {
+                entry->owner = core;
+            }
+        } else if (mine != NULL) {
+            entry->owner = core;
+        }
+        break;
+    }
+    case REQ_WRITE:
+    case REQ_UPGRADE:
+        if (req->type == REQ_UPGRADE) {
+            mc->coherence.upgrades++;
+        }
+        if (dir_invalidate_others(sim, entry, core, req->line_addr, req->bytes)) {
+            mc->coherence.c2c_transfers++;
+        } else if (req->type == REQ_WRITE) {
+            fetch_line(sim, core, req->line_addr);
+        }
+        entry->sharers = bit;
+        entry->owner = core;
+        break;
+    case REQ_WRITEBACK:
+        mc->coherence.writebacks++;
+        cs->mem_writes++;
+        /* fall through */
+    case REQ_EVICT:
+        if (entry != NULL) {
+            dir_remove_sharer(&sim->dir, entry, core);
+        }
+        break;
+    }
+}
+
+/**
+ * Drain every core's queue in (core-local time, core) order
+ */
+void serial_phase(ParallelSim *sim) {
+    for (;;) {
+        int next = -1;
+        unsigned int next_time = 0;
+        
+        for (int c = 0; c < sim->mc->num_cores; c++) {
+            CoherenceRequest *req = queue_peek(&sim->queues[c]);
+            if (req != NULL && (next < 0 || req->time < next_time)) {
+                next = c;
+                next_time = req->time;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        
+        process_request(sim, next, queue_peek(&sim->queues[next]));
+        queue_pop(&sim->queues[next]);
+    }
+}
+
+/**
+ * Read the whole trace from stdin into per-core record arrays
+ */
+void load_core_traces(ParallelSim *sim) {
+    TraceRecord rec;
+    
+    while (read_record(stdin, &rec)) {
+        if (rec.source >= sim->mc->num_cores) {
+            fprintf(stderr, "Warning: Invalid tenant %d, skipping\n", rec.source);
+            continue;
+        }
+        
+        CoreTrace *trace = &sim->traces[rec.source];
+        if (trace->count == trace->capacity) {
+            trace->capacity = trace->capacity ? 2 * trace->capacity : 4096;
+            trace->records = (TraceRecord *)realloc(trace->records,
+                                                    trace->capacity * sizeof(TraceRecord));
+            if (trace->records == NULL) {
+                fprintf(stderr, "Error: Failed to allocate core trace\n");
+                exit(1);
+            }
+        }
+        trace->records[trace->count++] = rec;
+    }
+}
+
+/**
+ * Simulate the multi-core system on worker threads, one quantum at a time
+ *
+ * Within a quantum each core touches only its own private cache, so the
+ * result depends only on the quantum, never on the thread count. Returns
+ * the number of quanta simulated.
+ */
+int run_parallel(ParallelSim *sim) {
+    int num_cores = sim->mc->num_cores;
+    int longest = 0;
+    
+    sim->traces = (CoreTrace *)calloc(num_cores, sizeof(CoreTrace));
+    sim->queues = (RequestQueue *)malloc(num_cores * sizeof(RequestQueue));
+    if (sim->traces == NULL || sim->queues == NULL) {
+        fprintf(stderr, "Error: Failed to allocate parallel state\n");
+        exit(1);
+    }
+    
+    load_core_traces(sim);
+    for (int c = 0; c < num_cores; c++) {
+        // At most an eviction and a miss request per access
+        init_queue(&sim->queues[c], 2 * sim->quantum + 1);
+        if (sim->traces[c].count > longest) {
+            longest = sim->traces[c].count;
+        }
+    }
+    
+    init_directory(&sim->dir, sim->dir_sets, sim->dir_ways, sim->dir_policy);
+    if (sim->has_llc) {
+        init_cache(&sim->llc, &sim->llc_config);
+    }
+    
+    pthread_t *threads = (pthread_t *)malloc(sim->num_threads * sizeof(pthread_t));
+    WorkerArg *args = (WorkerArg *)malloc(sim->num_threads * sizeof(WorkerArg));
+    if (threads == NULL || args == NULL) {
+        fprintf(stderr, "Error: Failed to allocate worker threads\n");
+        exit(1);
+    }
+    pthread_barrier_init(&sim->start_barrier, NULL, sim->num_threads + 1);
+    pthread_barrier_init(&sim->finish_barrier, NULL, sim->num_threads + 1);
+    sim->done = 0;
+    for (int w = 0; w < sim->num_threads; w++) {
+        args[w].sim = sim;
+        args[w].worker = w;
+        if (pthread_create(&threads[w], NULL, parallel_worker, &args[w]) != 0) {
+            fprintf(stderr, "Error: Failed to start worker thread\n");
+            exit(1);
+        }
+    }
+    
+    int num_quanta = (longest + sim->quantum - 1) / sim->quantum;
+    for (int q = 0; q < num_quanta; q++) {
+        sim->current_quantum = q;
+        pthread_barrier_wait(&sim->start_barrier);
+        pthread_barrier_wait(&sim->finish_barrier);
+        serial_phase(sim);
+    }
+    
+    sim->done = 1;
+    pthread_barrier_wait(&sim->start_barrier);
+    for (int w = 0; w < sim->num_threads; w++) {
+        pthread_join(threads[w], NULL);
+    }
+    pthread_barrier_destroy(&sim->start_barrier);
+    pthread_barrier_destroy(&sim->finish_barrier);
+    free(threads);
+    free(args);
+    
+    return num_quanta;
+}
+
+/**
+ * Print shared LLC and directory statistics of a parallel run
+ */
+void print_parallel_report(ParallelSim *sim, int num_quanta, double seconds) {
+    printf("\n");
+    printf("Parallel Simulation\n");
+    printf("==============================\n");
+    printf("Worker threads:    %d\n", sim->num_threads);
+    printf("Quantum:           %d accesses/core\n", sim->quantum);
+    printf("Quanta:            %d\n", num_quanta);
+    if (sim->has_llc) {
+        int total = sim->llc_stats.hits + sim->llc_stats.misses;
+        printf("LLC accesses:      %d\n", total);
+        printf("LLC hit rate:      %.2f%%\n",
+               total > 0 ? (100.0 * sim->llc_stats.hits / total) : 0.0);
+    }
+    printf("Simulation time:   %.3f s\n", seconds);
+}
+
+/**
+ * Free parallel simulation state
+ */
+void free_parallel(ParallelSim *sim) {
+    for (int c = 0; c < sim->mc->num_cores; c++) {
+        free(sim->traces[c].records);
+        free(sim->queues[c].slots);
+    }
+    free(sim->traces);
+    free(sim->queues);
+    free_directory(&sim->dir);
+    if (sim->has_llc) {
+        free_cache(sim->llc, sim->llc_config.num_sets);
+    }
+}
+
+/**
+ * Print per-tenant statistics and the allocation history
+ */
+void print_partition_report(PartitionState *ps) {
+    printf("\n");
+    printf("Per-Tenant Statistics\n");
+    printf("==============================\n");
+    printf("Tenant Mask     Accesses   Hits       Hit rate\n");
+    for (int t = 0; t < ps->num_tenants; t++) {
+        CacheStats *ts = &ps->tenant_stats[t];
+        int total = ts->hits + ts->misses;
+        printf("%-6d %08x %-10d %-10d %.2f%%\n", t, ps->way_mask[t], total, ts->hits,
+               total > 0 ? (100.0 * ts->hits / total) : 0.0);
+    }
+    
+    printf("\n");
+    printf("Partition Allocations\n");
+    printf("==============================\n");
+    printf("Epoch  Tenant Ways Accesses   Hit rate\n");
+    for (int e = 0; e < ps->num_epochs; e++) {
+        for (int t = 0; t < ps->num_tenants; t++) {
+            CacheStats *es = &ps->history[e].stats[t];
+            int total = es->hits + es->misses;
+            printf("%-6d %-6d %-4d %-10d %.2f%%\n", e, t, ps->history[e].ways[t], total,
+                   total > 0 ? (100.0 * es->hits / total) : 0.0);
+        }
+    }
+}
+
+/**
+ * Print command-line usage
+ */
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [options] < trace_file\n", prog);
+    fprintf(stderr, "       %s merge [--hit-latency C] [--mem-latency C] FILE...\n", prog);
+    fprintf(stderr, "  --way-mask T:MASK  Restrict fills by tenant T to ways in hex MASK\n");
+    fprintf(stderr, "  --ucp EPOCH        Utility-based partitioning every EPOCH accesses\n");
+    fprintf(stderr, "  --cores N          Multi-core mode with N coherent private caches\n");
+    fprintf(stderr, "  --protocol P       Coherence protocol: mesi (default) or moesi\n");
+    fprintf(stderr, "  --source F[:W]     Interleave trace F with weight W into a shared cache\n");
+    fprintf(stderr, "  --interleave M     Interleave sources by ratio (default) or time\n");
+    fprintf(stderr, "  --threads T        Parallel multi-core simulation on T threads\n");
+    fprintf(stderr, "  --quantum Q        Accesses per core per quantum (default %d)\n",
+            DEFAULT_QUANTUM);
+    fprintf(stderr, "  --llc S:W          Shared LLC with S sets and W ways (parallel mode)\n");
+    fprintf(stderr, "  --false-sharing N  Report the N worst falsely shared lines\n");
+    fprintf(stderr, "  --symbols FILE     Symbol map for false-sharing attribution\n");
+    fprintf(stderr, "  --directory S:W[:P] Sparse directory / snoop filter, policy lru or random\n");
+    fprintf(stderr, "  --interconnect T   Time misses over a bus, ring or mesh\n");
+    fprintf(stderr, "  --hop-latency N    Cycles per interconnect hop (default 1)\n");
+    fprintf(stderr, "  --link-bandwidth B Bytes per cycle per link (default 16)\n");
+    fprintf(stderr, "  --hit-latency N    Cache hit time in cycles (default 1)\n");
+    fprintf(stderr, "  --mem-latency N    Memory access time in cycles (default 100)\n");
+    fprintf(stderr, "  --configs FILE     Simulate every configuration in FILE in one pass\n");
+    fprintf(stderr, "  --simd M           Lane engine for 1/2-way --configs: auto, scalar, validate\n");
+    fprintf(stderr, "  --sweep FILE       Pool every trace in FILE with every --configs entry\n");
+    fprintf(stderr, "  --batch FILE       Run the trace.config cache over every trace in FILE\n");
+    fprintf(stderr, "  --workers N        Sweep and batch worker threads (default: online CPUs)\n");
+    fprintf(stderr, "  --checkpoint N:F   Save cache state to F after N trace records\n");
+    fprintf(stderr, "  --restore F        Continue from checkpoint F\n");
+    fprintf(stderr, "  --warmup N         Exclude the first N accesses from the statistics\n");
+    fprintf(stderr, "  --warmup-lines N   Exclude accesses until N distinct lines are touched\n");
+    fprintf(stderr, "  --shard I/N        Run shard I of N of a sweep or batch (partial output)\n");
+    fprintf(stderr, "  --numa             Pin pool workers across NUMA nodes, report per node\n");
+    fprintf(stderr, "  --result-cache DIR Reuse sweep and batch results stored in DIR\n");
+    fprintf(stderr, "  --result-cache-entries N  Result cache size bound (default %d)\n",
+            DEFAULT_RESULT_CACHE_ENTRIES);
+    fprintf(stderr, "  --set-shards T     Simulate on T threads, split by set index\n");
+    fprintf(stderr, "  --time-chunks T    Simulate trace chunks on T threads, then reconcile\n");
+    fprintf(stderr, "  --stack-distance N Results for associativities 1..N in one pass\n");
+    fprintf(stderr, "  --all-sets         Results for every power-of-two set count in one pass\n");
+    fprintf(stderr, "  --mrc FILE         Write miss-ratio curves of every geometry as CSV\n");
+    fprintf(stderr, "  --target-miss P    Smallest cache with miss rate <= P percent\n");
+    fprintf(stderr, "  --target-amat C    Smallest cache with AMAT <= C cycles\n");
+    fprintf(stderr, "  --reuse-distance   Fully associative LRU reuse-distance histogram\n");
+    fprintf(stderr, "  --shards-rate R    Sampled reuse distance at rate R (0 < R <= 1)\n");
+    fprintf(stderr, "  --shards-size S    Sampled reuse distance tracking at most S lines\n");
+    fprintf(stderr, "  --statstack R      Estimate LRU/random miss ratios from reuse samples\n");
+    fprintf(stderr, "  --reuse-samples F  Estimate from the reuse times listed in F\n");
+    fprintf(stderr, "  --statstack-eval   Compare estimates against full simulation\n");
+    fprintf(stderr, "  --set-sample N     Simulate one set in N and estimate with 95%% CIs\n");
+    fprintf(stderr, "  -q, --quiet        Suppress per-access output\n");
+}
+
+/**
+ * Order sets by sampling hash
+ */
+int compare_set_ranks(const void *a, const void *b) {
+    unsigned int x = ((const SetRank *)a)->hash;
+    unsigned int y = ((const SetRank *)b)->hash;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Choose num_sets / ratio sets by hash rank, so the sample is spread over
+ * the index space rather than a contiguous block
+ */
+void init_set_sample(SetSample *ss, CacheConfig *config, int ratio) {
+    SetRank *ranks = (SetRank *)malloc(config->num_sets * sizeof(SetRank));
+    
+    memset(ss, 0, sizeof(*ss));
+    ss->ratio = ratio;
+    ss->num_sampled = config->num_sets / ratio;
+    ss->sampled = (unsigned char *)calloc(config->num_sets, 1);
+    ss->accesses = (unsigned long long *)calloc(config->num_sets, sizeof(unsigned long long));
+    ss->misses = (unsigned long long *)calloc(config->num_sets, sizeof(unsigned long long));
+    ss->mem_reads = (unsigned long long *)calloc(config->num_sets, sizeof(unsigned long long));
+    if (ranks == NULL || ss->sampled == NULL || ss->accesses == NULL ||
+        ss->misses == NULL || ss->mem_reads == NULL) {
+        fprintf(stderr, "Error: Failed to allocate set sample\n");
+        exit(1);
+    }
+    
+    for (int s = 0; s < config->num_sets; s++) {
+        ranks[s].hash = shards_hash((unsigned int)s);
+        ranks[s].set = s;
+    }
+    qsort(ranks, config->num_sets, sizeof(SetRank), compare_set_ranks);
+    for (int k = 0; k < ss->num_sampled; k++) {
+        ss->sampled[ranks[k].set] = 1;
+    }
+    free(ranks);
+}
+
+/**
+ * Count one access and simulate it only if its set is sampled
+ */
+void set_sample_access(SetSample *ss, CacheLine **cache, CacheConfig *config,
+                       char type, unsigned int address) {
+    int is_read = type == 'R' || type == 'r';
+    unsigned int index = (address >> config->offset_bits) & (config->num_sets - 1);
+    
+    if (!is_read && type != 'W' && type != 'w') {
+        return;
+    }
+    ss->total++;
+    ss->writes += !is_read;
+    if (!ss->sampled[index]) {
+        return;
+    }
+    
+    int hit = access_cache(cache, config, type, address, (1u << config->associativity) - 1,
+                           0, NULL, &ss->stats);
+    ss->accesses[index]++;
+    if (!hit) {
+        ss->misses[index]++;
+        ss->mem_reads[index] += is_read;
+    }
+}
+
+/**
+ * Ratio estimate sum(y) / sum(accesses) over the sampled sets and its 95%
+ * confidence half-width (ratio estimator with finite population correction);
+ * the half-width is negative when it cannot be estimated
+ */
+double sample_ratio(SetSample *ss, int num_sets, unsigned long long *y,
+                    double *half_width) {
+    double sum_x = 0.0;
+    double sum_y = 0.0;
+    double ss_resid = 0.0;
+    int n = ss->num_sampled;
+    
+    for (int s = 0; s < num_sets; s++) {
+        if (ss->sampled[s]) {
+            sum_x += ss->accesses[s];
+            sum_y += y[s];
+        }
+    }
+    double r = sum_x > 0.0 ? sum_y / sum_x : 0.0;
+    
+    *half_width = -1.0;
+    if (n < 2 || sum_x == 0.0) {
+        return r;
+    }
+    for (int s = 0; s < num_sets; s++) {
+        if (ss->sampled[s]) {
+            double d = y[s] - r * ss->accesses[s];
+            ss_resid += d * d;
+        }
+    }
+    double mean_x = sum_x / n;
+    double var = (1.0 - (double)n / num_sets) * ss_resid / (n - 1) / (n * mean_x * mean_x);
+    *half_width = 1.96 * sqrt(var);
+    return r;
+}
+
+/**
+ * Print a rate and its confidence half-width
+ */
+void print_sample_rate(const char *label, double rate, double half_width) {
+    printf("%-19s%.2f%%", label, 100.0 * rate);
+    if (half_width >= 0.0) {
+        printf(" +/- %.2f%% (95%% CI)\n", 100.0 * half_width);
+    } else {
+        printf(" (no interval: too few sampled sets)\n");
+    }
+}
+
+/**
+ * Print a count scaled from the sample and its confidence half-width
+ */
+void print_sample_count(const char *label, double rate, double half_width,
+                        unsigned long long total) {
+    printf("%-19s%.0f", label, rate * total);
+    if (half_width >= 0.0) {
+        printf(" +/- %.0f\n", half_width * total);
+    } else {
+        printf("\n");
+    }
+}
+
+/**
+ * Print the scaled-up estimates and their confidence intervals
+ */
+void print_set_sample_report(SetSample *ss, CacheConfig *config, double seconds) {
+    unsigned long long simulated = (unsigned long long)ss->stats.hits + ss->stats.misses;
+    double miss_half;
+    double reads_half;
+    double miss_rate = sample_ratio(ss, config->num_sets, ss->misses, &miss_half);
+    double read_rate = sample_ratio(ss, config->num_sets, ss->mem_reads, &reads_half);
+    
+    printf("Set Sampling Estimate\n");
+    printf("==============================\n");
+    printf("Sampled sets:      %d of %d (1 in %d)\n", ss->num_sampled, config->num_sets,
+           ss->ratio);
+    printf("Total accesses:    %llu (%llu simulated)\n", ss->total, simulated);
+    printf("Simulation time:   %.2f ms\n", 1000.0 * seconds);
+    print_sample_rate("Hit rate:", simulated > 0 ? 1.0 - miss_rate : 0.0, miss_half);
+    print_sample_rate("Miss rate:", miss_rate, miss_half);
+    print_sample_count("Hits:", simulated > 0 ? 1.0 - miss_rate : 0.0, miss_half, ss->total);
+    print_sample_count("Misses:", miss_rate, miss_half, ss->total);
+    print_sample_count("Memory reads:", read_rate, reads_half, ss->total);
+    printf("Memory writes:     %llu (exact)\n", ss->writes);
+}
+
+/**
+ * Free set sample state
+ */
+void free_set_sample(SetSample *ss) {
+    free(ss->sampled);
+    free(ss->accesses);
+    free(ss->misses);
+    free(ss->mem_reads);
+}
+
+/**
+ * Save the cache, its statistics, the warmup and region state and the
+ * trace position to path
+ */
+int write_checkpoint(const char *path, CacheLine **cache, CacheConfig *config,
+                     CacheStats *stats, Warmup *warmup, LineMap *seen, RoiStats *roi,
+                     unsigned long long records, long long offset) {
+    CheckpointHeader header;
+    CheckpointLine *lines;
+    FILE *fp = fopen(path, "wb");
+    
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Cannot create checkpoint %s\n", path);
+        return 0;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "A9CKPT", 6);
+    header.version = CHECKPOINT_VERSION;
+    header.seen_lines = warmup->max_lines > 0 && warmup->active ? seen->count : 0;
+    header.header_size = sizeof(header) + sizeof(Warmup) + sizeof(RoiStats) +
+                         header.seen_lines * sizeof(unsigned int);
+    header.num_sets = config->num_sets;
+    header.associativity = config->associativity;
+    header.line_size = config->line_size;
+    header.records = records;
+    header.offset = offset;
+    header.stats = *stats;
+    
+    lines = (CheckpointLine *)calloc(config->associativity, sizeof(CheckpointLine));
+    if (lines == NULL) {
+        fprintf(stderr, "Error: Failed to allocate checkpoint buffer\n");
+        exit(1);
+    }
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(warmup, sizeof(Warmup), 1, fp) == 1 &&
+             fwrite(roi, sizeof(RoiStats), 1, fp) == 1;
+    for (unsigned int i = 0; header.seen_lines > 0 && i < seen->capacity && ok; i++) {
+        if (seen->keys[i] != LINEMAP_EMPTY) {
+            ok = fwrite(&seen->keys[i], sizeof(unsigned int), 1, fp) == 1;
+        }
+    }
+    for (int s = 0; s < config->num_sets && ok; s++) {
+        for (int w = 0; w < config->associativity; w++) {
+            lines[w].tag = cache[s][w].tag;
+            lines[w].valid = (unsigned char)cache[s][w].valid;
+            lines[w].lru = (unsigned char)cache[s][w].lru_counter;
+            lines[w].owner = (unsigned char)cache[s][w].owner;
+            lines[w].state = (unsigned char)cache[s][w].state;
+        }
+        ok = fwrite(lines, sizeof(CheckpointLine), config->associativity, fp) ==
+             (size_t)config->associativity;
+    }
+    free(lines);
+    if (fclose(fp) != 0 || !ok) {
+        fprintf(stderr, "Error: Failed to write checkpoint %s\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Map a checkpoint and load it into a cache of the same geometry
+ *
+ * Returns the number of trace records the checkpoint covers in *records
+ * and their byte length in *offset. The warmup and region state replace
+ * *warmup and *roi; seen is initialized when the warmup counts lines.
+ */
+int read_checkpoint(const char *path, CacheLine **cache, CacheConfig *config,
+                    CacheStats *stats, Warmup *warmup, LineMap *seen, RoiStats *roi,
+                    unsigned long long *records, long long *offset) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Cannot open checkpoint %s\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 0;
+    }
+    if ((size_t)st.st_size < sizeof(CheckpointHeader)) {
+        fprintf(stderr, "Error: %s is not a checkpoint\n", path);
+        close(fd);
+        return 0;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map checkpoint %s\n", path);
+        return 0;
+    }
+    
+    const CheckpointHeader *header = (const CheckpointHeader *)map;
+    int ok = 0;
+    if (memcmp(header->magic, "A9CKPT", 6) != 0) {
+        fprintf(stderr, "Error: %s is not a checkpoint\n", path);
+    } else if (header->version != CHECKPOINT_VERSION) {
+        fprintf(stderr, "Error: %s has checkpoint format v%u, expected v%d\n", path,
+                header->version, CHECKPOINT_VERSION);
+    } else if (header->num_sets != config->num_sets ||
+               header->associativity != config->associativity ||
+               header->line_size != config->line_size) {
+        fprintf(stderr, "Error: %s was taken with %d sets, %d ways and %d-byte lines\n",
+                path, header->num_sets, header->associativity, header->line_size);
+    } else if (header->header_size != sizeof(CheckpointHeader) + sizeof(Warmup) +
+               sizeof(RoiStats) + (size_t)header->seen_lines * sizeof(unsigned int) ||
+               (size_t)st.st_size < header->header_size + (size_t)config->num_sets *
+               config->associativity * sizeof(CheckpointLine)) {
+        fprintf(stderr, "Error: Checkpoint %s is truncated\n", path);
+    } else {
+        const char *state = (const char *)map + sizeof(CheckpointHeader);
+        memcpy(warmup, state, sizeof(Warmup));
+        memcpy(roi, state + sizeof(Warmup), sizeof(RoiStats));
+        if (roi->num_regions < 0 || roi->num_regions > MAX_ROIS ||
+            roi->open < -1 || roi->open >= roi->num_regions) {
+            roi->num_regions = 0;
+            roi->open = -1;
+        }
+        if (warmup->max_lines > 0) {
+            const unsigned int *lines =
+                (const unsigned int *)(state + sizeof(Warmup) + sizeof(RoiStats));
+            linemap_init(seen, 2 * header->seen_lines);
+            for (unsigned int i = 0; i < header->seen_lines; i++) {
+                linemap_insert(seen, lines[i]);
+            }
         }
         
-        printf("%c %08x %x %x %x %s %d\n",
-               access_type, address, tag, index, offset,
-               hit ? "hit " : "miss", 1); // Always 1 mem ref for writes
+        const CheckpointLine *lines =
+            (const CheckpointLine *)((const char *)map + header->header_size);
+        for (int s = 0; s < config->num_sets; s++) {
+            for (int w = 0; w < config->associativity; w++) {
+                const CheckpointLine *line = &lines[s * config->associativity + w];
+                cache[s][w].tag = line->tag;
+                cache[s][w].valid = line->valid;
+                cache[s][w].lru_counter = line->lru;
+                cache[s][w].owner = line->owner;
+                cache[s][w].state = line->state;
+                cache[s][w].touched = 0;
+            }
+        }
+        *stats = header->stats;
+        *records = header->records;
+        *offset = header->offset;
+        ok = 1;
     }
+    
+    munmap(map, st.st_size);
+    return ok;
 }
 
 /**
- * Free cache memory
+ * Count one access of the warmup phase; ends it once the access or
+ * distinct-line budget is used up
  */
-void free_cache(CacheLine **cache, int num_sets) {
-    for (int i = 0; i < num_sets; i++) {
-        free(cache[i]);
+void warmup_access(Warmup *warmup, LineMap *seen, CacheConfig *config,
+                   unsigned int address) {
+    if (warmup->max_lines > 0) {
+        linemap_insert(seen, address >> config->offset_bits);
+        warmup->active = seen->count < warmup->max_lines;
+    } else {
+        warmup->active = (unsigned long long)(warmup->stats.hits + warmup->stats.misses) <
+                         warmup->max_accesses;
     }
-    free(cache);
 }
 
 /**
- * Validate cache configuration parameters
+ * Apply a marker record: M:start[:name] opens a region (reopening one of
+ * the same name adds to it), M:stop closes it and M:reset zeroes the open
+ * region, or the whole-run statistics outside a region
  */
-int validate_config(CacheConfig *config) {
-    // Check range limits
-    if (config->num_sets <= 0 || config->num_sets > MAX_CACHE_SETS) {
-        fprintf(stderr, "Error: Number of sets must be 1-%d\n", MAX_CACHE_SETS);
+void roi_marker(RoiStats *roi, const char *line, CacheStats *stats) {
+    char command[16];
+    char name[ROI_NAME_LEN];
+    
+    name[0] = '\0';
+    if (sscanf(line, "M:%15[^:\r\n]:%31[^\r\n]", command, name) < 1) {
+        fprintf(stderr, "Warning: Malformed marker, skipping\n");
+        return;
+    }
+    
+    if (strcmp(command, "start") == 0) {
+        if (name[0] == '\0') {
+            snprintf(name, sizeof(name), "roi%d", roi->num_regions);
+        }
+        int r = 0;
+        while (r < roi->num_regions && strcmp(roi->names[r], name) != 0) {
+            r++;
+        }
+        if (r == roi->num_regions) {
+            if (r == MAX_ROIS) {
+                fprintf(stderr, "Warning: At most %d regions of interest, ignoring %s\n",
+                        MAX_ROIS, name);
+                return;
+            }
+            strcpy(roi->names[r], name);
+            memset(&roi->stats[r], 0, sizeof(CacheStats));
+            roi->num_regions++;
+        }
+        if (roi->open >= 0 && roi->open != r) {
+            fprintf(stderr, "Warning: Region %s starts inside %s; closing %s\n", name,
+                    roi->names[roi->open], roi->names[roi->open]);
+        }
+        roi->open = r;
+    } else if (strcmp(command, "stop") == 0) {
+        if (roi->open < 0) {
+            fprintf(stderr, "Warning: M:stop outside a region, skipping\n");
+        }
+        roi->open = -1;
+    } else if (strcmp(command, "reset") == 0) {
+        memset(roi->open >= 0 ? &roi->stats[roi->open] : stats, 0, sizeof(CacheStats));
+    } else {
+        fprintf(stderr, "Warning: Unknown marker '%s', skipping\n", command);
+    }
+}
+
+/**
+ * Print one statistics block per region of interest
+ */
+void print_roi_report(RoiStats *roi) {
+    printf("\nRegions of Interest\n");
+    printf("===================\n");
+    printf("%-16s %10s %10s %10s %8s %10s %10s\n", "Region", "Accesses", "Hits",
+           "Misses", "Hit rate", "Mem reads", "Mem writes");
+    for (int r = 0; r < roi->num_regions; r++) {
+        CacheStats *cs = &roi->stats[r];
+        int total = cs->hits + cs->misses;
+        printf("%-16s %10d %10d %10d %7.2f%% %10d %10d\n", roi->names[r], total, cs->hits,
+               cs->misses, total > 0 ? 100.0 * cs->hits / total : 0.0, cs->mem_reads,
+               cs->mem_writes);
+    }
+}
+
+/**
+ * Parse command-line options
+ */
+int parse_args(int argc, char *argv[], SimOptions *opts, PartitionState *ps) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--way-mask") == 0 && i + 1 < argc) {
+            int tenant;
+            unsigned int mask;
+            if (sscanf(argv[++i], "%d:%x", &tenant, &mask) != 2 ||
+                tenant < 0 || tenant >= MAX_TENANTS || mask == 0) {
+                fprintf(stderr, "Error: Invalid way mask '%s'\n", argv[i]);
+                return 0;
+            }
+            ps->way_mask[tenant] = mask;
+            ps->enabled = 1;
+        } else if (strcmp(argv[i], "--ucp") == 0 && i + 1 < argc) {
+            ps->ucp_epoch = atoi(argv[++i]);
+            if (ps->ucp_epoch <= 0) {
+                fprintf(stderr, "Error: UCP epoch must be positive\n");
+                return 0;
+            }
+            ps->enabled = 1;
+        } else if (strcmp(argv[i], "--cores") == 0 && i + 1 < argc) {
+            opts->num_cores = atoi(argv[++i]);
+            if (opts->num_cores <= 0 || opts->num_cores > MAX_CORES) {
+                fprintf(stderr, "Error: Core count must be 1-%d\n", MAX_CORES);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--protocol") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "mesi") == 0) {
+                opts->protocol = PROTOCOL_MESI;
+            } else if (strcmp(argv[i], "moesi") == 0) {
+                opts->protocol = PROTOCOL_MOESI;
+            } else {
+                fprintf(stderr, "Error: Unknown protocol '%s'\n", argv[i]);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--source") == 0 && i + 1 < argc) {
+            if (opts->num_sources == MAX_SOURCES) {
+                fprintf(stderr, "Error: At most %d trace sources\n", MAX_SOURCES);
+                return 0;
+            }
+            char *path = argv[++i];
+            char *weight = strrchr(path, ':');
+            int w = 1;
+            if (weight != NULL && weight[1] != '\0' &&
+                strspn(weight + 1, "0123456789") == strlen(weight + 1)) {
+                *weight = '\0';
+                w = atoi(weight + 1);
+            }
+            if (w <= 0) {
+                fprintf(stderr, "Error: Source weight must be positive\n");
+                return 0;
+            }
+            opts->source_path[opts->num_sources] = path;
+            opts->source_weight[opts->num_sources++] = w;
+        } else if (strcmp(argv[i], "--interleave") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "ratio") == 0) {
+                opts->by_timestamp = 0;
+            } else if (strcmp(argv[i], "time") == 0) {
+                opts->by_timestamp = 1;
+            } else {
+                fprintf(stderr, "Error: Unknown interleaving '%s'\n", argv[i]);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opts->num_threads = atoi(argv[++i]);
+            if (opts->num_threads <= 0) {
+                fprintf(stderr, "Error: Thread count must be positive\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--quantum") == 0 && i + 1 < argc) {
+            opts->quantum = atoi(argv[++i]);
+            if (opts->quantum <= 0) {
+                fprintf(stderr, "Error: Quantum must be positive\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--llc") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d:%d", &opts->llc_sets, &opts->llc_ways) != 2) {
+                fprintf(stderr, "Error: Invalid LLC geometry '%s'\n", argv[i]);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--false-sharing") == 0 && i + 1 < argc) {
+            opts->false_sharing_top = atoi(argv[++i]);
+            if (opts->false_sharing_top <= 0) {
+                fprintf(stderr, "Error: False-sharing report size must be positive\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--symbols") == 0 && i + 1 < argc) {
+            opts->symbol_path = argv[++i];
+        } else if (strcmp(argv[i], "--directory") == 0 && i + 1 < argc) {
+            char policy[16] = "lru";
+            if (sscanf(argv[++i], "%d:%d:%15s", &opts->dir_sets, &opts->dir_ways, policy) < 2 ||
+                opts->dir_sets <= 0 || opts->dir_ways <= 0) {
+                fprintf(stderr, "Error: Invalid directory geometry '%s'\n", argv[i]);
+                return 0;
+            }
+            if (strcmp(policy, "lru") == 0) {
+                opts->dir_policy = DIR_LRU;
+            } else if (strcmp(policy, "random") == 0) {
+                opts->dir_policy = DIR_RANDOM;
+            } else {
+                fprintf(stderr, "Error: Unknown directory policy '%s'\n", policy);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--interconnect") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "bus") == 0) {
+                opts->topology = NET_BUS;
+            } else if (strcmp(argv[i], "ring") == 0) {
+                opts->topology = NET_RING;
+            } else if (strcmp(argv[i], "mesh") == 0) {
+                opts->topology = NET_MESH;
+            } else {
+                fprintf(stderr, "Error: Unknown interconnect '%s'\n", argv[i]);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--hop-latency") == 0 && i + 1 < argc) {
+            opts->hop_latency = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--link-bandwidth") == 0 && i + 1 < argc) {
+            opts->link_bandwidth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hit-latency") == 0 && i + 1 < argc) {
+            opts->hit_latency = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mem-latency") == 0 && i + 1 < argc) {
+            opts->mem_latency = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--configs") == 0 && i + 1 < argc) {
+            opts->configs_path = argv[++i];
+        } else if (strcmp(argv[i], "--simd") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "auto") == 0) {
+                opts->simd = SIMD_AUTO;
+            } else if (strcmp(argv[i], "scalar") == 0) {
+                opts->simd = SIMD_SCALAR;
+            } else if (strcmp(argv[i], "validate") == 0) {
+                opts->simd = SIMD_VALIDATE;
+            } else {
+                fprintf(stderr, "Error: Unknown SIMD mode '%s'\n", argv[i]);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            opts->sweep_path = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            opts->batch_path = argv[++i];
+        } else if (strcmp(argv[i], "--result-cache") == 0 && i + 1 < argc) {
+            opts->result_cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--result-cache-entries") == 0 && i + 1 < argc) {
+            opts->result_cache_entries = atoi(argv[++i]);
+            if (opts->result_cache_entries <= 0) {
+                fprintf(stderr, "Error: Result cache entries must be positive\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            char *colon;
+            i++;
+            opts->checkpoint_at = strtoull(argv[i], &colon, 10);
+            if (colon == argv[i] || *colon != ':' || colon[1] == '\0') {
+                fprintf(stderr, "Error: Invalid checkpoint '%s' (expected N:FILE)\n",
+                        argv[i]);
+                return 0;
+            }
+            opts->checkpoint_path = colon + 1;
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            opts->warmup_accesses = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--warmup-lines") == 0 && i + 1 < argc) {
+            opts->warmup_lines = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            opts->restore_path = argv[++i];
+        } else if (strcmp(argv[i], "--numa") == 0) {
+            opts->numa = 1;
+        } else if (strcmp(argv[i], "--shard") == 0 && i + 1 < argc) {
+            i++;
+            if (sscanf(argv[i], "%d/%d", &opts->shard_index, &opts->shard_count) != 2 ||
+                opts->shard_count < 1 || opts->shard_index < 0 ||
+                opts->shard_index >= opts->shard_count) {
+                fprintf(stderr, "Error: Invalid shard '%s' (expected I/N with 0 <= I < N)\n",
+                        argv[i]);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            opts->num_workers = atoi(argv[++i]);
+            if (opts->num_workers <= 0) {
+                fprintf(stderr, "Error: Workers must be positive\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--set-shards") == 0 && i + 1 < argc) {
+            opts->set_shards = atoi(argv[++i]);
+            if (opts->set_shards <= 0) {
+                fprintf(stderr, "Error: Set shards must be positive\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--time-chunks") == 0 && i + 1 < argc) {
+            opts->time_chunks = atoi(argv[++i]);
+            if (opts->time_chunks <= 0 || opts->time_chunks > MAX_CORES) {
+                fprintf(stderr, "Error: Time chunks must be 1-%d\n", MAX_CORES);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--stack-distance") == 0 && i + 1 < argc) {
+            opts->stack_depth = atoi(argv[++i]);
+            if (opts->stack_depth <= 0 || opts->stack_depth > MAX_STACK_DEPTH) {
+                fprintf(stderr, "Error: Stack depth must be 1-%d\n", MAX_STACK_DEPTH);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--all-sets") == 0) {
+            opts->all_sets = 1;
+        } else if (strcmp(argv[i], "--mrc") == 0 && i + 1 < argc) {
+            opts->mrc_path = argv[++i];
+        } else if (strcmp(argv[i], "--target-miss") == 0 && i + 1 < argc) {
+            opts->target_miss = atof(argv[++i]);
+            if (opts->target_miss <= 0.0 || opts->target_miss > 100.0) {
+                fprintf(stderr, "Error: Target miss rate must be in (0, 100]\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--target-amat") == 0 && i + 1 < argc) {
+            opts->target_amat = atof(argv[++i]);
+            if (opts->target_amat <= 0.0) {
+                fprintf(stderr, "Error: Target AMAT must be positive\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--reuse-distance") == 0) {
+            opts->reuse_distance = 1;
+        } else if (strcmp(argv[i], "--shards-rate") == 0 && i + 1 < argc) {
+            opts->shards_rate = atof(argv[++i]);
+            opts->reuse_distance = 1;
+            if (opts->shards_rate <= 0.0 || opts->shards_rate > 1.0) {
+                fprintf(stderr, "Error: Sampling rate must be in (0, 1]\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--shards-size") == 0 && i + 1 < argc) {
+            opts->shards_size = atoi(argv[++i]);
+            opts->reuse_distance = 1;
+            if (opts->shards_size <= 0) {
+                fprintf(stderr, "Error: Sample size must be positive\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--statstack") == 0 && i + 1 < argc) {
+            opts->statstack_rate = atof(argv[++i]);
+            if (opts->statstack_rate <= 0.0 || opts->statstack_rate > 1.0) {
+                fprintf(stderr, "Error: Sampling rate must be in (0, 1]\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--reuse-samples") == 0 && i + 1 < argc) {
+            opts->reuse_samples_path = argv[++i];
+        } else if (strcmp(argv[i], "--set-sample") == 0 && i + 1 < argc) {
+            opts->set_sample = atoi(argv[++i]);
+            if (opts->set_sample < 2 || (opts->set_sample & (opts->set_sample - 1)) != 0) {
+                fprintf(stderr, "Error: Set sample ratio must be a power of 2 >= 2\n");
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--statstack-eval") == 0) {
+            opts->statstack_eval = 1;
+        } else if (strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quiet") == 0) {
+            opts->quiet = 1;
+        } else {
+            print_usage(argv[0]);
+            return 0;
+        }
+    }
+    
+    if ((opts->num_cores > 0 || opts->num_sources > 0) && ps->enabled) {
+        fprintf(stderr, "Error: Way partitioning applies to the single-cache mode only\n");
         return 0;
     }
     
-    if (config->associativity <= 0 || config->associativity > MAX_ASSOCIATIVITY) {
-        fprintf(stderr, "Error: Associativity must be 1-%d\n", MAX_ASSOCIATIVITY);
+    if (opts->num_cores > 0 && opts->num_sources > 0) {
+        fprintf(stderr, "Error: --cores and --source are mutually exclusive\n");
         return 0;
     }
     
-    if (config->line_size < 8 || config->line_size > MAX_LINE_SIZE) {
-        fprintf(stderr, "Error: Line size must be 8-%d bytes\n", MAX_LINE_SIZE);
+    if ((opts->num_threads > 0 || opts->llc_sets > 0 || opts->false_sharing_top > 0 ||
+         opts->dir_sets > 0 || opts->topology != NET_NONE) && opts->num_cores == 0) {
+        fprintf(stderr, "Error: --threads, --llc, --false-sharing, --directory and "
+                "--interconnect require --cores\n");
         return 0;
     }
     
-    // Check power of 2
-    if ((config->num_sets & (config->num_sets - 1)) != 0) {
-        fprintf(stderr, "Error: Number of sets must be a power of 2\n");
+    if (opts->configs_path != NULL &&
+        (opts->num_cores > 0 || opts->num_sources > 0 || ps->enabled)) {
+        fprintf(stderr, "Error: --configs cannot be combined with --cores, --source "
+                "or partitioning\n");
         return 0;
     }
     
-    if ((config->line_size & (config->line_size - 1)) != 0) {
-        fprintf(stderr, "Error: Line size must be a power of 2\n");
+    if ((opts->set_shards > 0 || opts->time_chunks > 0) &&
+        (opts->num_cores > 0 || opts->num_sources > 0 || opts->configs_path != NULL ||
+         ps->enabled)) {
+        fprintf(stderr, "Error: --set-shards and --time-chunks apply to a single cache "
+                "without partitioning\n");
+        return 0;
+    }
+    
+    if (opts->set_shards > 0 && opts->time_chunks > 0) {
+        fprintf(stderr, "Error: Choose one of --set-shards and --time-chunks\n");
+        return 0;
+    }
+    
+    int profiling = opts->mrc_path != NULL || opts->target_miss > 0.0 ||
+                    opts->target_amat > 0.0;
+    int statstack = opts->statstack_rate > 0.0 || opts->reuse_samples_path != NULL;
+    int sampling = opts->set_sample > 0;
+    
+    if (opts->statstack_eval && opts->statstack_rate == 0.0) {
+        fprintf(stderr, "Error: --statstack-eval requires --statstack\n");
+        return 0;
+    }
+    if (opts->statstack_rate > 0.0 && opts->reuse_samples_path != NULL) {
+        fprintf(stderr, "Error: Choose one of --statstack and --reuse-samples\n");
+        return 0;
+    }
+    if ((opts->stack_depth > 0 || opts->all_sets || opts->reuse_distance || profiling ||
+         statstack || sampling) &&
+        (opts->num_cores > 0 || opts->num_sources > 0 || opts->configs_path != NULL ||
+         opts->set_shards > 0 || opts->time_chunks > 0 || ps->enabled)) {
+        fprintf(stderr, "Error: Profiling modes apply to a single cache without "
+                "partitioning\n");
+        return 0;
+    }
+    
+    if ((opts->stack_depth > 0) + opts->all_sets + opts->reuse_distance + profiling +
+        statstack + sampling > 1) {
+        fprintf(stderr, "Error: Choose one of --stack-distance, --all-sets, "
+                "--reuse-distance, --mrc / --target-*, --statstack and --set-sample\n");
+        return 0;
+    }
+    
+    if (opts->simd != SIMD_OFF && (opts->configs_path == NULL || opts->sweep_path != NULL)) {
+        fprintf(stderr, "Error: --simd requires --configs without --sweep\n");
+        return 0;
+    }
+    
+    if (opts->batch_path != NULL &&
+        (opts->num_cores > 0 || opts->num_sources > 0 || opts->configs_path != NULL ||
+         opts->set_shards > 0 || opts->time_chunks > 0 || ps->enabled)) {
+        fprintf(stderr, "Error: --batch runs the single trace.config cache only\n");
+        return 0;
+    }
+    
+    if (opts->sweep_path != NULL && opts->configs_path == NULL) {
+        fprintf(stderr, "Error: --sweep requires --configs\n");
+        return 0;
+    }
+    
+    if ((opts->checkpoint_path != NULL || opts->restore_path != NULL) &&
+        (opts->num_cores > 0 || opts->num_sources > 0 || opts->configs_path != NULL ||
+         opts->batch_path != NULL || opts->stack_depth > 0 || opts->all_sets ||
+         opts->reuse_distance || profiling || statstack || sampling || ps->enabled)) {
+        fprintf(stderr, "Error: --checkpoint and --restore apply to a single cache "
+                "without partitioning\n");
+        return 0;
+    }
+    if ((opts->warmup_accesses > 0 || opts->warmup_lines > 0) &&
+        (opts->num_cores > 0 || opts->num_sources > 0 || opts->configs_path != NULL ||
+         opts->batch_path != NULL || opts->set_shards > 0 || opts->time_chunks > 0 ||
+         opts->stack_depth > 0 || opts->all_sets || opts->reuse_distance || profiling ||
+         statstack || sampling)) {
+        fprintf(stderr, "Error: --warmup applies to the sequential single-cache "
+                "simulation\n");
+        return 0;
+    }
+    if (opts->warmup_accesses > 0 && opts->warmup_lines > 0) {
+        fprintf(stderr, "Error: Choose one of --warmup and --warmup-lines\n");
+        return 0;
+    }
+    if ((opts->warmup_accesses > 0 || opts->warmup_lines > 0) && opts->restore_path != NULL) {
+        fprintf(stderr, "Error: --restore continues the warmup saved in the checkpoint\n");
+        return 0;
+    }
+    
+    if (opts->checkpoint_path != NULL && (opts->set_shards > 0 || opts->time_chunks > 0)) {
+        fprintf(stderr, "Error: --checkpoint requires the sequential simulation\n");
+        return 0;
+    }
+    
+    if (opts->numa && opts->sweep_path == NULL && opts->batch_path == NULL &&
+        opts->set_shards == 0 && opts->time_chunks == 0) {
+        fprintf(stderr, "Error: --numa requires --sweep, --batch, --set-shards or "
+                "--time-chunks\n");
+        return 0;
+    }
+    
+    if ((opts->result_cache_dir != NULL || opts->result_cache_entries > 0) &&
+        (opts->sweep_path == NULL && opts->batch_path == NULL)) {
+        fprintf(stderr, "Error: --result-cache requires --sweep or --batch\n");
+        return 0;
+    }
+    if (opts->result_cache_entries > 0 && opts->result_cache_dir == NULL) {
+        fprintf(stderr, "Error: --result-cache-entries requires --result-cache\n");
+        return 0;
+    }
+    
+    if (opts->shard_count > 0 && opts->sweep_path == NULL && opts->batch_path == NULL) {
+        fprintf(stderr, "Error: --shard requires --sweep or --batch\n");
+        return 0;
+    }
+    
+    if (opts->topology != NET_NONE && opts->num_threads > 0) {
+        fprintf(stderr, "Error: --interconnect applies to the sequential multi-core mode\n");
         return 0;
     }
     
+    if (opts->hop_latency < 0 || opts->link_bandwidth < 0 ||
+        opts->hit_latency < 0 || opts->mem_latency < 0) {
+        fprintf(stderr, "Error: Latencies and bandwidth must not be negative\n");
+        return 0;
+    }
+    if (opts->link_bandwidth == 0) {
+        opts->link_bandwidth = 16;
+    }
+    
+    if (opts->symbol_path != NULL && opts->false_sharing_top == 0) {
+        fprintf(stderr, "Error: --symbols requires --false-sharing\n");
+        return 0;
+    }
+    
+    if (opts->llc_sets > 0 && opts->num_threads == 0) {
+        fprintf(stderr, "Error: --llc requires --threads\n");
+        return 0;
+    }
+    
+    if (opts->quantum == 0) {
+        opts->quantum = DEFAULT_QUANTUM;
+    }
+    
+    if (opts->num_threads > 0) {
+        opts->quiet = 1;  // Accesses of different cores are not globally ordered
+    }
+    
     return 1;
 }
 
 /**
  * Main simulation function
  */
-int main(void) {
+int main(int argc, char *argv[]) {
+    SimOptions opts;
+    PartitionState partition;
+    memset(&opts, 0, sizeof(opts));
+    opts.hop_latency = 1;
+    opts.hit_latency = 1;
+    opts.mem_latency = 100;
+    memset(&partition, 0, sizeof(partition));
+    if (argc > 1 && strcmp(argv[1], "merge") == 0) {
+        return run_merge(argc - 2, argv + 2);
+    }
+    if (!parse_args(argc, argv, &opts, &partition)) {
+        return 1;
+    }
+    
+    if (opts.configs_path != NULL) {
+        ConfigSweep sweep;
+        if (!load_configs(&sweep, opts.configs_path)) {
+            return 1;
+        }
+        
+        if (opts.sweep_path != NULL) {
+            static SweepJobs jobs;
+            NumaTopology numa;
+            ResultCache result_cache;
+            for (int c = 0; c < sweep.num_configs; c++) {
+                if (sweep.output[c] != NULL) {
+                    fprintf(stderr, "Error: Per-access output is not supported with --sweep\n");
+                    return 1;
+                }
+            }
+            jobs.configs = &sweep;
+            if (!load_sweep_traces(&jobs, opts.sweep_path)) {
+                return 1;
+            }
+            if (opts.num_workers == 0) {
+                long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+                opts.num_workers = cpus > 0 ? (int)cpus : 1;
+            }
+            if (opts.numa) {
+                init_numa(&numa, opts.num_workers);
+                jobs.numa = &numa;
+            }
+            if (opts.result_cache_dir != NULL) {
+                if (!init_result_cache(&result_cache, opts.result_cache_dir,
+                                       opts.result_cache_entries)) {
+                    return 1;
+                }
+                jobs.result_cache = &result_cache;
+            }
+            run_pool_sweep(&jobs, opts.num_workers, opts.shard_index, opts.shard_count);
+            free_sweep_jobs(&jobs);
+            if (opts.numa) {
+                free_numa(&numa);
+            }
+            return 0;
+        }
+        
+        if (opts.simd != SIMD_OFF) {
+            for (int c = 0; c < sweep.num_configs; c++) {
+                if (sweep.configs[c].associativity > 2 || sweep.output[c] != NULL) {
+                    fprintf(stderr, "Error: --simd supports 1- and 2-way caches without "
+                            "per-access output\n");
+                    return 1;
+                }
+            }
+            int ok = run_simd_sweep(&sweep, opts.simd);
+            print_sweep_report(&sweep);
+            free_sweep(&sweep);
+            return ok ? 0 : 1;
+        }
+        
+        init_sweep(&sweep);
+        run_sweep(&sweep);
+        print_sweep_report(&sweep);
+        free_sweep(&sweep);
+        return 0;
+    }
+    
     FILE *config_file = fopen("trace.config", "r");
     if (!config_file) {
         fprintf(stderr, "Error: Cannot open trace.config file\n");
@@ -267,6 +7175,7 @@ int main(void) {
     
     // Read configuration
     CacheConfig config;
+    TraceRecord rec;
     if (fscanf(config_file, "Number of sets: %d\nSet size: %d\nLine size: %d",
                &config.num_sets, &config.associativity, &config.line_size) != 3) {
         fprintf(stderr, "Error: Invalid trace.config format\n");
@@ -280,6 +7189,189 @@ int main(void) {
         return 1;
     }
     
+    if (opts.batch_path != NULL) {
+        static BatchRun batch;
+        NumaTopology numa;
+        ResultCache result_cache;
+        batch.config = &config;
+        config.offset_bits = log2_int(config.line_size);
+        config.index_bits = log2_int(config.num_sets);
+        if (!load_sweep_traces(&batch.jobs, opts.batch_path)) {
+            return 1;
+        }
+        if (opts.num_workers == 0) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            opts.num_workers = cpus > 0 ? (int)cpus : 1;
+        }
+        if (opts.numa) {
+            init_numa(&numa, opts.num_workers);
+            batch.jobs.numa = &numa;
+        }
+        if (opts.result_cache_dir != NULL) {
+            if (!init_result_cache(&result_cache, opts.result_cache_dir,
+                                   opts.result_cache_entries)) {
+                return 1;
+            }
+            batch.jobs.result_cache = &result_cache;
+        }
+        run_batch(&batch, opts.num_workers, opts.shard_index, opts.shard_count);
+        free_sweep_jobs(&batch.jobs);
+        if (opts.numa) {
+            free_numa(&numa);
+        }
+        return 0;
+    }
+    
+    if (opts.stack_depth > 0) {
+        StackDistance sd;
+        config.offset_bits = log2_int(config.line_size);
+        config.index_bits = log2_int(config.num_sets);
+        init_stack_distance(&sd, &config, opts.stack_depth);
+        while (read_record(stdin, &rec)) {
+            stack_access(&sd, &config, rec.type, rec.address);
+        }
+        print_stack_distance_report(&sd, &config);
+        free_stack_distance(&sd);
+        return 0;
+    }
+    
+    if (opts.all_sets) {
+        AllSets as;
+        config.offset_bits = log2_int(config.line_size);
+        init_all_sets(&as, config.associativity);
+        while (read_record(stdin, &rec)) {
+            all_sets_access(&as, &config, rec.type, rec.address);
+        }
+        print_all_sets_report(&as, &config);
+        free_all_sets(&as);
+        return 0;
+    }
+    
+    if (opts.mrc_path != NULL || opts.target_miss > 0.0 || opts.target_amat > 0.0) {
+        static MrcProfile mrc;
+        init_mrc(&mrc);
+        while (read_record(stdin, &rec)) {
+            mrc_access(&mrc, rec.type, rec.address);
+        }
+        if (opts.mrc_path != NULL && !write_mrc_csv(&mrc, &opts, opts.mrc_path)) {
+            return 1;
+        }
+        if (opts.target_miss > 0.0 || opts.target_amat > 0.0) {
+            print_sizing_recommendation(&mrc, &opts);
+        }
+        free_mrc(&mrc);
+        return 0;
+    }
+    
+    if (opts.statstack_rate > 0.0 || opts.reuse_samples_path != NULL) {
+        StatStack ss;
+        ReuseDistance rd;
+        RandomCache random[STATSTACK_SIZES];
+        
+        config.offset_bits = log2_int(config.line_size);
+        init_statstack(&ss, opts.statstack_rate);
+        if (opts.reuse_samples_path != NULL &&
+            !load_reuse_samples(&ss, opts.reuse_samples_path)) {
+            return 1;
+        }
+        if (opts.statstack_eval) {
+            init_reuse_distance(&rd, 1u << 20);
+            for (int b = 0; b < STATSTACK_SIZES; b++) {
+                init_random_cache(&random[b], 1u << b, 12345u + b);
+            }
+        }
+        
+        while (opts.statstack_rate > 0.0 && read_record(stdin, &rec)) {
+            statstack_access(&ss, &config, rec.type, rec.address);
+            if (opts.statstack_eval && (rec.type == 'R' || rec.type == 'r' ||
+                                        rec.type == 'W' || rec.type == 'w')) {
+                reuse_access(&rd, &config, rec.type, rec.address);
+                for (int b = 0; b < STATSTACK_SIZES; b++) {
+                    random_cache_access(&random[b], rec.address >> config.offset_bits);
+                }
+            }
+        }
+        if (ss.count + ss.dangling + (int)ss.watch.count == 0) {
+            fprintf(stderr, "Error: No reuse samples taken; raise the sampling rate\n");
+            return 1;
+        }
+        
+        double start = now_seconds();
+        statstack_finish(&ss);
+        for (int b = 0; b < STATSTACK_SIZES; b++) {
+            statstack_lru_miss(&ss, 1u << b);
+            statcache_random_miss(&ss, 1u << b);
+        }
+        double seconds = now_seconds() - start;
+        
+        print_statstack_report(&ss, &config, seconds, opts.statstack_eval ? &rd : NULL,
+                               random);
+        free_statstack(&ss);
+        if (opts.statstack_eval) {
+            free_reuse_distance(&rd);
+            for (int b = 0; b < STATSTACK_SIZES; b++) {
+                free_random_cache(&random[b]);
+            }
+        }
+        return 0;
+    }
+    
+    if (opts.set_sample > 0) {
+        SetSample ss;
+        CacheLine **cache;
+        if (opts.set_sample > config.num_sets) {
+            fprintf(stderr, "Error: Cannot sample 1 in %d of %d sets\n", opts.set_sample,
+                    config.num_sets);
+            return 1;
+        }
+        init_cache(&cache, &config);
+        init_set_sample(&ss, &config, opts.set_sample);
+        double start = now_seconds();
+        while (read_record(stdin, &rec)) {
+            set_sample_access(&ss, cache, &config, rec.type, rec.address);
+        }
+        print_set_sample_report(&ss, &config, now_seconds() - start);
+        free_set_sample(&ss);
+        free_cache(cache, config.num_sets);
+        return 0;
+    }
+    
+    if (opts.reuse_distance) {
+        ReuseDistance rd;
+        config.offset_bits = log2_int(config.line_size);
+        init_reuse_distance(&rd, 1u << 20);
+        if (opts.shards_rate > 0.0 || opts.shards_size > 0) {
+            init_shards(&rd, opts.shards_rate, opts.shards_size);
+        }
+        while (read_record(stdin, &rec)) {
+            reuse_access(&rd, &config, rec.type, rec.address);
+        }
+        print_reuse_distance_report(&rd, &config);
+        free_reuse_distance(&rd);
+        return 0;
+    }
+    
+    unsigned int all_ways = (1u << config.associativity) - 1;
+    for (int t = 0; t < MAX_TENANTS; t++) {
+        if ((partition.way_mask[t] & ~all_ways) != 0) {
+            fprintf(stderr, "Error: Way mask %x exceeds %d ways\n",
+                    partition.way_mask[t], config.associativity);
+            return 1;
+        }
+    }
+    
+    ParallelSim psim;
+    memset(&psim, 0, sizeof(psim));
+    if (opts.llc_sets > 0) {
+        psim.has_llc = 1;
+        psim.llc_config.num_sets = opts.llc_sets;
+        psim.llc_config.associativity = opts.llc_ways;
+        psim.llc_config.line_size = config.line_size;
+        if (!validate_config(&psim.llc_config)) {
+            return 1;
+        }
+    }
+    
     // Display configuration
     printf("Cache Simulator Configuration\n");
     printf("==============================\n");
@@ -288,65 +7380,324 @@ int main(void) {
     printf("Line size:         %d bytes\n", config.line_size);
     printf("Total cache size:  %d bytes\n", 
            config.num_sets * config.associativity * config.line_size);
+    if (opts.num_cores > 0) {
+        printf("Cores:             %d (private caches, %s)\n", opts.num_cores,
+               opts.protocol == PROTOCOL_MOESI ? "MOESI" : "MESI");
+    }
+    if (opts.llc_sets > 0) {
+        printf("Shared LLC:        %d sets, %d ways\n", opts.llc_sets, opts.llc_ways);
+    }
     printf("\n");
     
     // Initialize cache
     CacheLine **cache;
     init_cache(&cache, &config);
+    init_partition(&partition, &config);
+    
+    MultiCore mc;
+    memset(&mc, 0, sizeof(mc));
+    FalseSharing sharing;
+    SymbolMap symbols;
+    if (opts.num_cores > 0) {
+        init_multicore(&mc, &config, opts.num_cores, opts.protocol);
+    }
+    if (opts.false_sharing_top > 0) {
+        init_false_sharing(&sharing);
+        mc.sharing = &sharing;
+    }
+    if (opts.symbol_path != NULL && !load_symbols(&symbols, opts.symbol_path)) {
+        return 1;
+    }
+    
+    Directory filter;
+    if (opts.dir_sets > 0 && opts.num_threads == 0) {
+        init_directory(&filter, opts.dir_sets, opts.dir_ways, opts.dir_policy);
+        mc.filter = &filter;
+    }
+    
+    Interconnect net;
+    if (opts.topology != NET_NONE) {
+        init_interconnect(&net, opts.topology, opts.num_cores,
+                          opts.hop_latency, opts.link_bandwidth);
+        mc.net = &net;
+        mc.hit_latency = opts.hit_latency;
+        mc.mem_latency = opts.mem_latency;
+        mc.cycles = (unsigned long long *)calloc(opts.num_cores, sizeof(unsigned long long));
+        mc.first_cycle = (unsigned long long *)malloc(opts.num_cores *
+                                                      sizeof(unsigned long long));
+        if (mc.cycles == NULL || mc.first_cycle == NULL) {
+            fprintf(stderr, "Error: Failed to allocate core clocks\n");
+            return 1;
+        }
+        memset(mc.first_cycle, 0xff, opts.num_cores * sizeof(unsigned long long));
+    }
     
     // Initialize statistics
     CacheStats stats = {0, 0, 0, 0};
+    CacheTotals totals = {0, 0, 0, 0};    // Modes whose counts may pass 2^31
+    unsigned long long records = 0;
+    
+    Warmup warmup;
+    LineMap warmup_seen;
+    RoiStats roi;
+    memset(&warmup, 0, sizeof(warmup));
+    warmup.max_accesses = opts.warmup_accesses;
+    warmup.max_lines = opts.warmup_lines;
+    warmup.active = warmup.max_accesses > 0 || warmup.max_lines > 0;
+    roi.num_regions = 0;
+    roi.open = -1;
+    
+    if (opts.restore_path != NULL) {
+        long long offset;
+        if (!read_checkpoint(opts.restore_path, cache, &config, &stats, &warmup,
+                             &warmup_seen, &roi, &records, &offset)) {
+            return 1;
+        }
+        // Seek past the covered records, or read them if stdin is a pipe
+        if (offset < 0 || fseek(stdin, (long)offset, SEEK_SET) != 0) {
+            unsigned long long skipped = 0;
+            while (skipped < records && read_record(stdin, &rec)) {
+                skipped++;
+            }
+        }
+    } else if (warmup.max_lines > 0) {
+        linemap_init(&warmup_seen, 1024);
+    }
+    int checkpoint_due = opts.checkpoint_path != NULL;
+    
+    if (checkpoint_due && opts.checkpoint_at < records) {
+        fprintf(stderr, "Error: Checkpoint at record %llu precedes the restored record %llu\n",
+                opts.checkpoint_at, records);
+        return 1;
+    }
     
     // Print header
-    printf("Type Address  Tag      Index Offset Result MemRefs\n");
-    printf("---- -------- -------- ----- ------ ------ -------\n");
+    if (opts.quiet) {
+        // Summary only
+    } else if (opts.num_cores > 0) {
+        printf("Type Address  Tag      Index Offset Result MemRefs Core Class\n");
+        printf("---- -------- -------- ----- ------ ------ ------- ---- ---------\n");
+    } else {
+        printf("Type Address  Tag      Index Offset Result MemRefs\n");
+        printf("---- -------- -------- ----- ------ ------ -------\n");
+    }
     
     // Process trace
-    char access_type;
-    int size;
-    unsigned int address;
+    SharedCache shared;
+    NumaTopology numa;
     char line[256];
     
-    while (fgets(line, sizeof(line), stdin)) {
+    int num_quanta = 0;
+    double sim_seconds = 0.0;
+    
+    if (opts.num_sources > 0) {
+        init_shared(&shared, &opts);
+        run_shared(&shared, cache, &config, &stats, opts.quiet);
+    } else if (opts.set_shards > 0) {
+        if (opts.numa) {
+            init_numa(&numa, opts.set_shards);
+        }
+        run_sharded(cache, &config, &totals, opts.set_shards, opts.quiet,
+                    opts.numa ? &numa : NULL);
+        if (opts.numa) {
+            free_numa(&numa);
+        }
+    } else if (opts.time_chunks > 0) {
+        if (opts.numa) {
+            init_numa(&numa, opts.time_chunks);
+        }
+        run_chunked(cache, &config, &stats, opts.time_chunks, opts.quiet,
+                    opts.numa ? &numa : NULL);
+        if (opts.numa) {
+            free_numa(&numa);
+        }
+    } else if (opts.num_threads > 0) {
+        psim.mc = &mc;
+        psim.num_threads = opts.num_threads;
+        psim.quantum = opts.quantum;
+        psim.dir_sets = opts.dir_sets;
+        psim.dir_ways = opts.dir_ways;
+        psim.dir_policy = opts.dir_policy;
+        double start = now_seconds();
+        num_quanta = run_parallel(&psim);
+        sim_seconds = now_seconds() - start;
+    }
+    
+    while (opts.num_sources == 0 && opts.num_threads == 0 && opts.set_shards == 0 &&
+           opts.time_chunks == 0 &&
+           fgets(line, sizeof(line), stdin)) {
+        if (line[0] == 'M' && line[1] == ':') {
+            if (opts.num_cores == 0) {
+                roi_marker(&roi, line, &stats);
+            }
+            continue;
+        }
+        
         // Parse input line
-        if (sscanf(line, "%c:%d:%x", &access_type, &size, &address) != 3) {
-            continue; // Skip malformed lines
+        if (!parse_record(line, &rec)) {
+            continue;
         }
+        if (checkpoint_due && records == opts.checkpoint_at) {
+            long pos = ftell(stdin);
+            if (!write_checkpoint(opts.checkpoint_path, cache, &config, &stats, &warmup,
+                                  &warmup_seen, &roi, records,
+                                  pos < 0 ? -1 : pos - (long)strlen(line))) {
+                return 1;
+            }
+            checkpoint_due = 0;
+        }
+        records++;
         
-        // Validate access size
-        if (size != 1 && size != 2 && size != 4 && size != 8) {
-            fprintf(stderr, "Warning: Invalid access size %d, skipping\n", size);
+        // Validate tenant id against the active mode
+        int tenant = rec.source;
+        if ((partition.ucp_epoch > 0 && tenant >= config.associativity) ||
+            (opts.num_cores > 0 && tenant >= opts.num_cores) ||
+            (opts.num_cores == 0 && tenant >= MAX_TENANTS)) {
+            fprintf(stderr, "Warning: Invalid tenant %d, skipping\n", tenant);
             continue;
         }
         
-        // Check alignment
-        if ((address & (size - 1)) != 0) {
-            fprintf(stderr, "Warning: Misaligned access at 0x%x, skipping\n", address);
+        if (opts.num_cores > 0) {
+            simulate_core_access(&mc, tenant, rec.type, rec.address, rec.size, opts.quiet);
             continue;
         }
         
-        // Simulate cache access
-        access_cache(cache, &config, access_type, address, &stats);
+        // Simulate cache access; warmup accesses fill the cache uncounted
+        int warming = warmup.active;
+        int hit = access_cache(cache, &config, rec.type, rec.address,
+                               partition.way_mask[tenant], tenant, NULL,
+                               warming ? &warmup.stats : &stats);
+        if (hit >= 0 && !opts.quiet) {
+            print_access(stdout, &config, rec.type, rec.address, hit);
+        }
+        if (hit >= 0 && warming) {
+            warmup_access(&warmup, &warmup_seen, &config, rec.address);
+        } else if (hit >= 0 && roi.open >= 0) {
+            record_access(&roi.stats[roi.open], rec.type, hit);
+        }
+        
+        if (hit >= 0 && partition.enabled) {
+            if (tenant >= partition.num_tenants) {
+                partition.num_tenants = tenant + 1;
+            }
+            if (!warming) {
+                record_access(&partition.tenant_stats[tenant], rec.type, hit);
+            }
+            record_access(&partition.epoch_stats[tenant], rec.type, hit);
+            
+            if (partition.ucp_epoch > 0) {
+                umon_access(&partition, &config, tenant, rec.address,
+                            rec.type == 'R' || rec.type == 'r');
+                if (++partition.epoch_accesses == partition.ucp_epoch) {
+                    ucp_repartition(&partition, &config);
+                    partition.epoch_accesses = 0;
+                }
+            }
+        }
+    }
+    
+    if (checkpoint_due && records == opts.checkpoint_at) {
+        long pos = ftell(stdin);
+        if (!write_checkpoint(opts.checkpoint_path, cache, &config, &stats, &warmup,
+                              &warmup_seen, &roi, records, pos)) {
+            return 1;
+        }
+        checkpoint_due = 0;
+    }
+    if (checkpoint_due) {
+        fprintf(stderr, "Warning: Trace ended after %llu records; no checkpoint written\n",
+                records);
+    }
+    
+    if (opts.num_cores > 0) {
+        for (int c = 0; c < opts.num_cores; c++) {
+            CacheStats *cs = &mc.core_stats[c].stats;
+            stats.hits += cs->hits;
+            stats.misses += cs->misses;
+            stats.mem_reads += cs->mem_reads;
+            stats.mem_writes += cs->mem_writes;
+        }
     }
     
     // Print summary statistics
-    int total_accesses = stats.hits + stats.misses;
+    totals.hits += stats.hits;
+    totals.misses += stats.misses;
+    totals.mem_reads += stats.mem_reads;
+    totals.mem_writes += stats.mem_writes;
+    unsigned long long total_accesses = totals.hits + totals.misses;
     printf("\n");
     printf("Simulation Summary Statistics\n");
     printf("==============================\n");
-    printf("Total accesses:    %d\n", total_accesses);
-    printf("Hits:              %d\n", stats.hits);
-    printf("Misses:            %d\n", stats.misses);
+    printf("Total accesses:    %llu\n", total_accesses);
+    printf("Hits:              %llu\n", totals.hits);
+    printf("Misses:            %llu\n", totals.misses);
     printf("Hit rate:          %.2f%%\n", 
-           total_accesses > 0 ? (100.0 * stats.hits / total_accesses) : 0.0);
+           total_accesses > 0 ? (100.0 * totals.hits / total_accesses) : 0.0);
     printf("Miss rate:         %.2f%%\n",
-           total_accesses > 0 ? (100.0 * stats.misses / total_accesses) : 0.0);
-    printf("Memory reads:      %d\n", stats.mem_reads);
-    printf("Memory writes:     %d\n", stats.mem_writes);
-    printf("Total memory refs: %d\n", stats.mem_reads + stats.mem_writes);
+           total_accesses > 0 ? (100.0 * totals.misses / total_accesses) : 0.0);
+    printf("Memory reads:      %llu\n", totals.mem_reads);
+    printf("Memory writes:     %llu\n", totals.mem_writes);
+    printf("Total memory refs: %llu\n", totals.mem_reads + totals.mem_writes);
+    if (warmup.max_accesses > 0 || warmup.max_lines > 0) {
+        printf("Warmup accesses:   %d (excluded%s)\n",
+               warmup.stats.hits + warmup.stats.misses,
+               warmup.active ? "; trace ended during warmup" : "");
+    }
+    if (roi.num_regions > 0) {
+        print_roi_report(&roi);
+    }
+    if (warmup.max_lines > 0) {
+        linemap_free(&warmup_seen);
+    }
+    
+    if (partition.enabled) {
+        if (partition.num_epochs == 0 || partition.epoch_accesses > 0) {
+            close_partition_epoch(&partition, &config);
+        }
+        print_partition_report(&partition);
+    }
+    
+    if (opts.num_threads > 0) {
+        print_parallel_report(&psim, num_quanta, sim_seconds);
+        print_directory_report(&psim.dir, &mc);
+        free_parallel(&psim);
+    }
+    
+    if (mc.filter != NULL) {
+        print_directory_report(&filter, &mc);
+        free_directory(&filter);
+    }
+    
+    if (mc.net != NULL) {
+        print_interconnect_report(&net, &mc);
+        free_interconnect(&net);
+        free(mc.cycles);
+        free(mc.first_cycle);
+    }
+    
+    if (opts.num_cores > 0) {
+        print_multicore_report(&mc);
+        free_multicore(&mc);
+    }
+    
+    if (opts.false_sharing_top > 0) {
+        print_false_sharing_report(&sharing, &config,
+                                   opts.symbol_path ? &symbols : NULL,
+                                   opts.false_sharing_top);
+        free_false_sharing(&sharing);
+    }
+    if (opts.symbol_path != NULL) {
+        free(symbols.symbols);
+    }
+    
+    if (opts.num_sources > 0) {
+        print_shared_report(&shared, &opts);
+        free_shared(&shared);
+    }
     
     // Cleanup
     free_cache(cache, config.num_sets);
+    free_partition(&partition);
     
     return 0;
 }
@@ -7,9 +7,21 @@ echo "Cache Simulator Test Suite"
 echo "========================================="
 echo ""
 
+failures=0
+
+# Report PASS when the argument is 1, FAIL otherwise
+check_result() {
+    if [ "$1" = "1" ]; then
+        echo "PASS"
+    else
+        echo "FAIL"
+        failures=$((failures + 1))
+    fi
+}
+
 # Test 1: Basic Hit/Miss Pattern
 echo "Test 1: Basic Hit/Miss Pattern"
-echo "==============================="
+echo "=============================="
 cat > test1_trace.txt << EOF
 R:4:00000000
 R:4:00000004
@@ -56,7 +68,7 @@ echo ""
 
 # Test 3: Write-Through Policy
 echo "Test 3: Write-Through Policy"
-echo "============================="
+echo "============================"
 cat > test3_trace.txt << EOF
 R:4:00000000
 W:4:00000000
@@ -119,6 +131,773 @@ echo "Expected: All hits after first miss (same cache line)"
 grep "Hit rate" test5_output.txt
 echo ""
 
+# Test 6: Way Partitioning
+echo "Test 6: Way Partitioning"
+echo "========================"
+cat > test6_trace.txt << EOF
+R:4:00000000:0
+R:4:00000010:1
+R:4:00000020:1
+R:4:00000000:0
+EOF
+
+cat > trace.config << EOF
+Number of sets: 1
+Set size: 2
+Line size: 16
+EOF
+
+./cache_simulator --way-mask 0:1 --way-mask 1:2 < test6_trace.txt > test6_output.txt
+echo "Expected: Tenant 1 cannot evict tenant 0's way, so 0x00000000 hits"
+grep -A4 "Per-Tenant" test6_output.txt | tail -2
+echo ""
+
+# Test 7: High Thread Ids
+echo "Test 7: High Thread Ids"
+echo "======================="
+cat > test7_trace.txt << EOF
+R:4:00000000:0
+R:4:00000100:20
+R:4:00000100:20
+R:4:00000200:63
+EOF
+
+cat > trace.config << EOF
+Number of sets: 16
+Set size: 2
+Line size: 16
+EOF
+
+./cache_simulator --cores 64 < test7_trace.txt > test7_output.txt 2>&1
+echo "Expected: Cores 20 and 63 receive their accesses; no thread id is rejected"
+grep -E "^(20|63) " test7_output.txt
+check_result $(awk '/^20 / { a = $2 } /^63 / { b = $2 } /Invalid tenant/ { bad = 1 }
+                    END { print (a == 2 && b == 1 && !bad) }' test7_output.txt)
+echo ""
+
+# Test 8: Interleaved Trace Sources
+echo "Test 8: Interleaved Trace Sources"
+echo "================================="
+awk 'BEGIN { for (i = 1; i <= 6; i++) printf "R:4:0000a%d00:0:%d\n", i, i * 10 }' > test8_a.txt
+cat > test8_b.txt << EOF
+R:4:0000b100:0:15
+R:4:0000b200:0:16
+R:4:0000b300:0:60
+EOF
+cat > trace.config << EOF
+Number of sets: 1
+Set size: 1
+Line size: 16
+EOF
+
+./cache_simulator --source test8_a.txt:3 --source test8_b.txt:1 > test8_output.txt 2>&1
+ratio=$(awk '/^R / { printf "%s ", substr($2, 5, 2) }' test8_output.txt)
+# Equal timestamps go to the lower source number
+time_order=$(./cache_simulator --source test8_a.txt --source test8_b.txt --interleave time |
+             awk '/^R / { printf "%s ", substr($2, 5, 2) }')
+echo "Expected: 3:1 rounds, then the rest of b; timestamp order with ties to a;"
+echo "          a loses 2 lines to b and b loses 1 to a"
+echo "  3:1:  $ratio"
+echo "  time: $time_order"
+sed -n '/^Stolen Evictions/,$p' test8_output.txt
+check_result $(awk -v ratio="$ratio" -v t="$time_order" '$1 == 0 && NF == 3 { a = $3 } $1 == 1 && NF == 3 { b = $2 }
+                    END { print (ratio == "a1 a2 a3 b1 a4 a5 a6 b2 b3 " &&
+                                 t == "a1 b1 b2 a2 a3 a4 a5 a6 b3 " && a == 2 && b == 1) }' \
+                    test8_output.txt)
+echo ""
+
+# Test 9: High Thread Ids With Worker Threads
+echo "Test 9: High Thread Ids With Worker Threads"
+echo "==========================================="
+./cache_simulator -q --cores 64 --threads 4 < test7_trace.txt > test9_output.txt 2>&1
+echo "Expected: Same per-core counts as the single-threaded run in Test 7"
+grep -E "^(20|63) " test9_output.txt
+check_result $(awk '/^20 / { a = $2 } /^63 / { b = $2 } /Invalid tenant/ { bad = 1 }
+                    END { print (a == 2 && b == 1 && !bad) }' test9_output.txt)
+echo ""
+
+# Test 10: False Sharing Attribution
+echo "Test 10: False Sharing Attribution"
+echo "=================================="
+# Cores 0 and 1 ping-pong disjoint counters in one line; 0x2000 is truly shared
+cat > test10_trace.txt << EOF
+W:4:00001000:0
+W:4:00001020:1
+W:4:00001000:0
+W:4:00001020:1
+W:4:00002000:0
+R:4:00002000:1
+W:4:00002000:1
+EOF
+cat > test10_symbols.txt << EOF
+0000000000001000 0000000000000004 D counter_a
+0000000000001020 0000000000000004 D counter_b
+2000 40 shared_flag
+EOF
+cat > trace.config << EOF
+Number of sets: 16
+Set size: 2
+Line size: 64
+EOF
+
+./cache_simulator -q --cores 2 --false-sharing 5 --symbols test10_symbols.txt \
+    < test10_trace.txt > test10_output.txt 2>&1
+echo "Expected: 3 of 4 write invalidations are false, all on line 00001000,"
+echo "          attributed to counter_a (core 0) and counter_b (core 1)"
+sed -n '/^Write invalidations/,$p' test10_output.txt
+check_result $(awk '/^Write invalidations:/ { inval = $3 } /^False sharing:/ { fs = $3 }
+                    /^0000/ { rows++; row = $0 }
+                    END { print (inval == 4 && fs == 3 && rows == 1 &&
+                                 row == "00001000 3      3      c1:32-35 [counter_b] c0:0-3 [counter_a]") }' \
+                    test10_output.txt)
+echo ""
+
+# Test 11: Sparse Directory
+echo "Test 11: Sparse Directory"
+echo "========================="
+awk 'BEGIN { x = 5; for (i = 0; i < 4000; i++) { x = (x * 1103515245 + 12345) % 2147483648;
+             y = int(x / 65536); printf "%s:4:%08x:%d\n", (y % 3 == 0) ? "W" : "R", (y % 64) * 32,
+             int(y / 64) % 4 } }' > test11_trace.txt
+cat > trace.config << EOF
+Number of sets: 16
+Set size: 2
+Line size: 32
+EOF
+
+./cache_simulator -q --cores 4 < test11_trace.txt > test11_broadcast.txt 2>&1
+./cache_simulator -q --cores 4 --directory 64:4 < test11_trace.txt 2>&1 | \
+    sed '/^Directory$/,/^$/d' > test11_filtered.txt
+# A writes, B evicts its entry (1 dirty copy), A evicts B's (1), then A is
+# shared by both cores and B evicts it again (2)
+cat > test11_trace.txt << EOF
+W:4:00000000:0
+R:4:00000020:0
+R:4:00000000:1
+R:4:00000000:0
+R:4:00000020:1
+EOF
+cat > trace.config << EOF
+Number of sets: 4
+Set size: 2
+Line size: 32
+EOF
+
+./cache_simulator -q --cores 2 --directory 1:1 < test11_trace.txt > test11_output.txt 2>&1
+echo "Expected: A directory that never evicts matches broadcast snooping; a 1-entry"
+echo "          directory makes 3 evictions, 4 back-invalidations and 1 writeback"
+sed -n '/^Evictions/p;/^Back-invalidations/p;/^Writebacks/p' test11_output.txt
+check_result $(cmp -s test11_broadcast.txt test11_filtered.txt &&
+               awk '/^Evictions:/ { e = $2 } /^Back-invalidations:/ { b = $2 }
+                    /^Writebacks:/ { w = $2 } /^0 / && NF == 7 { d = $7 }
+                    END { print (e == 3 && b == 4 && w == 1 && d == 1) }' test11_output.txt)
+rm -f test11_broadcast.txt test11_filtered.txt
+echo ""
+
+# Test 12: Interconnect Link Scheduling
+echo "Test 12: Interconnect Link Scheduling"
+echo "====================================="
+cat > trace.config << EOF
+Number of sets: 16
+Set size: 2
+Line size: 16
+EOF
+
+# Core 1 misses, core 0 runs 200 misses ahead, then core 1 misses again at
+# a cycle when the bus is idle
+{
+    echo "R:4:00100000:1"
+    awk 'BEGIN { for (i = 0; i < 200; i++) printf "R:4:%08x:0\n", i * 4096 }'
+    echo "R:4:00100000:1"
+    echo "R:4:00100000:1"
+    echo "R:4:00200000:1"
+} > test12_trace.txt
+./cache_simulator -q --cores 2 --interconnect bus < test12_trace.txt > test12_output.txt 2>&1
+echo "Expected: The lagging core's messages see no queueing delay"
+sed -n '/^Avg queue delay/p' test12_output.txt
+check_result $(awk '/^Avg queue delay/ { d = $4 } END { print (d == "0.00") }' test12_output.txt)
+echo ""
+
+# Test 13: Multi-Configuration Sweep
+echo "Test 13: Multi-Configuration Sweep"
+echo "=================================="
+awk 'BEGIN { x = 3; for (i = 0; i < 4000; i++) { x = (x * 1103515245 + 12345) % 2147483648;
+             y = int(x / 65536); printf "%s:4:%08x\n", (y % 4 == 0) ? "W" : "R", (y % 2048) * 8 } }' \
+    > test13_trace.txt
+cat > test13_configs.txt << EOF
+# sets ways line [per-access output]
+64 4 32 test13_accesses.txt
+16 1 16
+128 8 64
+1 2 8
+EOF
+
+./cache_simulator --configs test13_configs.txt < test13_trace.txt > test13_output.txt 2>&1
+ok=1
+while read sets ways line log; do
+    case "$sets" in "#"*) continue ;; esac
+    cat > trace.config << EOF
+Number of sets: $sets
+Set size: $ways
+Line size: $line
+EOF
+    ./cache_simulator < test13_trace.txt > test13_single.txt 2>&1
+    awk -v s=$sets -v w=$ways -v l=$line '
+        FNR == NR { if (/^Total accesses:/) t = $3; if (/^Hits:/) h = $2
+                    if (/^Memory reads:/) r = $3; if (/^Memory writes:/) m = $3; next }
+        $1 == s && $2 == w && $3 == l { found = ($5 == t && $6 == h && $8 == r && $9 == m) }
+        END { exit !found }' test13_single.txt test13_output.txt || ok=0
+    if [ -n "$log" ]; then
+        grep -E "^[RW] " test13_single.txt | cmp -s - "$log" || ok=0
+    fi
+done < test13_configs.txt
+echo "Expected: Every row and the per-access file equal a single-configuration run"
+sed -n '/^Sets/,$p' test13_output.txt
+check_result $ok
+rm -f test13_single.txt test13_accesses.txt
+echo ""
+
+# Test 14: Pooled Sweep Ordering
+echo "Test 14: Pooled Sweep Ordering"
+echo "=============================="
+cat > test14_short.txt << EOF
+R:4:00000000
+W:4:00000040
+R:4:00000000
+EOF
+awk 'BEGIN { x = 7; for (i = 0; i < 3000; i++) { x = (x * 1103515245 + 12345) % 2147483648;
+     printf "%s:4:%08x\n", (x % 5 == 0) ? "W" : "R", (x % 16384) * 4 } }' > test14_long.txt
+head -500 test14_long.txt > test14_mid.txt
+printf "test14_short.txt\ntest14_long.txt\ntest14_mid.txt\n" > test14_traces.txt
+printf "16 2 16\n64 4 32\n8 1 8\n" > test14_configs.txt
+
+./cache_simulator --configs test14_configs.txt --sweep test14_traces.txt --workers 2 \
+    > test14_output.txt 2> /dev/null
+echo "Expected: Every sweep row equals a single-configuration run (longest trace not first)"
+test14_ok=1
+while read sets ways line; do
+    printf "Number of sets: %d\nSet size: %d\nLine size: %d\n" $sets $ways $line > trace.config
+    for trace in test14_short.txt test14_long.txt test14_mid.txt; do
+        hits=$(./cache_simulator -q < $trace | awk '/^Hits:/ { print $2 }')
+        row=$(grep "^$trace,$sets,$ways,$line," test14_output.txt | cut -d, -f6)
+        [ "$hits" = "$row" ] || test14_ok=0
+    done
+done < test14_configs.txt
+check_result $test14_ok
+echo ""
+
+# Test 15: Set-Sharded Simulation
+echo "Test 15: Set-Sharded Simulation"
+echo "==============================="
+cat > trace.config << EOF
+Number of sets: 16
+Set size: 2
+Line size: 16
+EOF
+
+./cache_simulator < test14_long.txt > test15_sequential.txt 2>&1
+./cache_simulator --set-shards 4 < test14_long.txt > test15_output.txt 2>&1
+echo "Expected: Per-access lines and summary equal the sequential run"
+check_result $(cmp -s test15_output.txt test15_sequential.txt && echo 1)
+echo ""
+
+# Test 16: Stack-Distance Exactness
+echo "Test 16: Stack-Distance Exactness"
+echo "================================="
+cat > test16_trace.txt << EOF
+R:4:00000100
+R:4:00000200
+W:4:00000100
+R:4:00000200
+EOF
+
+cat > trace.config << EOF
+Number of sets: 1
+Set size: 2
+Line size: 16
+EOF
+
+./cache_simulator --stack-distance 2 < test16_trace.txt > test16_output.txt 2>&1
+hits=$(./cache_simulator -q < test16_trace.txt | awk '/^Hits:/ { print $2 }')
+echo "Expected: The 1-way row is marked inexact (the write hits at depth 2);"
+echo "          the 2-way row is exact and matches a direct run"
+sed -n '/^Ways/,/^$/p' test16_output.txt
+check_result $(awk -v h=$hits '$1 == 1 && NF == 8 { one = $8 } $1 == 2 && NF == 8 { two = $8; hits = $3 }
+                              END { print (one == "no" && two == "yes" && hits == h) }' \
+                              test16_output.txt)
+echo ""
+
+# Test 17: All-Sets With Writes
+echo "Test 17: All-Sets With Writes"
+echo "============================="
+# The write to 0x40 hits it with 2 sets but misses with 1 set
+cat > test17_trace.txt << EOF
+R:4:00000040
+R:4:00000020
+R:4:00000060
+R:4:00000000
+W:4:00000040
+R:4:00000080
+R:4:00000000
+EOF
+
+cat > trace.config << EOF
+Number of sets: 1
+Set size: 2
+Line size: 32
+EOF
+
+./cache_simulator --all-sets < test17_trace.txt > test17_output.txt 2>&1
+ok=1
+for sets in 1 2 4; do
+    cat > trace.config << EOF
+Number of sets: $sets
+Set size: 2
+Line size: 32
+EOF
+    hits=$(./cache_simulator -q < test17_trace.txt | awk '/^Hits:/ { print $2 }')
+    awk -v s=$sets -v h=$hits '$1 == s && NF == 7 { found = ($3 == h) } END { exit !found }' \
+        test17_output.txt || ok=0
+done
+echo "Expected: Every set count matches a direct run (1 hit with 1 set)"
+sed -n '/^Sets/,/^4 /p' test17_output.txt
+check_result $ok
+echo ""
+
+# Test 18: Reuse Distance
+echo "Test 18: Reuse Distance"
+echo "======================="
+# Reads only: every access allocates, as the profile assumes
+awk 'BEGIN { x = 9; for (i = 0; i < 5000; i++) { x = (x * 1103515245 + 12345) % 2147483648;
+             y = int(x / 65536); printf "R:4:%08x\n", ((y % 3 == 0) ? y % 40 : y % 6) * 32 } }' \
+    > test18_trace.txt
+cat > trace.config << EOF
+Number of sets: 1
+Set size: 8
+Line size: 32
+EOF
+
+./cache_simulator --reuse-distance < test18_trace.txt > test18_output.txt 2>&1
+ok=1
+for ways in 1 2 4 8; do
+    cat > trace.config << EOF
+Number of sets: 1
+Set size: $ways
+Line size: 32
+EOF
+    hits=$(./cache_simulator -q < test18_trace.txt | awk '/^Hits:/ { print $2 }')
+    awk -v w=$ways -v h=$hits '/^[0-9]/ && NF == 4 { sum += $2; if ($3 == w) found = (sum == h) }
+                               END { exit !found }' test18_output.txt || ok=0
+done
+echo "Expected: Distances below N lines add up to the hits of an N-way, 1-set cache"
+sed -n '/^Distance/,/^4-7 /p' test18_output.txt
+check_result $ok
+rm -f test18_trace.txt
+echo ""
+
+# Test 19: SHARDS Sampling
+echo "Test 19: SHARDS Sampling"
+echo "========================"
+awk 'BEGIN { x = 17; for (i = 0; i < 40000; i++) { x = (x * 1103515245 + 12345) % 2147483648;
+             y = int(x / 65536); z = (y % 4 == 0) ? y % 16384 : (y % 4 == 1) ? y % 1024 : y % 128;
+             printf "%s:4:%08x\n", (y % 7 == 0) ? "W" : "R", z * 32 } }' > test19_trace.txt
+cat > trace.config << EOF
+Number of sets: 64
+Set size: 4
+Line size: 32
+EOF
+
+./cache_simulator --reuse-distance < test19_trace.txt > test19_exact.txt 2>&1
+./cache_simulator --shards-rate 0.1 < test19_trace.txt > test19_output.txt 2>&1
+./cache_simulator --shards-size 512 < test19_trace.txt > test19_sized.txt 2>&1
+# Distances shorter than a few sampling periods are not resolved, so only
+# caches of 128 lines and more are compared
+ok=1
+for f in test19_output.txt test19_sized.txt; do
+    awk '/^[0-9]/ && NF == 4 { exact[$3] = $4 + 0; next }
+         /^Tracked lines:/ { tracked = $3 }
+         /^[0-9]/ && NF == 5 && $3 >= 128 { n++; d = $4 - exact[$3]; if (d < 0) d = -d
+                                            if (d > 2 * $5 + 1) bad = 1 }
+         END { exit !(n >= 5 && !bad && tracked <= 512) }' test19_exact.txt $f || ok=0
+done
+echo "Expected: Hit rates from 128 lines up are within two standard errors (+1%)"
+echo "          of the exact profile, and --shards-size 512 tracks <= 512 lines"
+sed -n '/^Sampling rate/p;/^Tracked lines/p' test19_output.txt test19_sized.txt
+check_result $ok
+rm -f test19_trace.txt test19_exact.txt test19_sized.txt
+echo ""
+
+# Test 20: Miss-Ratio Curves and Sizing
+echo "Test 20: Miss-Ratio Curves and Sizing"
+echo "====================================="
+awk 'BEGIN { x = 13; for (i = 0; i < 5000; i++) { x = (x * 1103515245 + 12345) % 2147483648;
+             y = int(x / 65536); printf "%s:4:%08x\n", (y % 5 == 0) ? "W" : "R", (y % 4096) * 4 } }' \
+    > test20_trace.txt
+./cache_simulator --mrc test20_mrc.csv --target-miss 40 < test20_trace.txt > test20_output.txt 2>&1
+ok=1
+# Rows marked exact must equal a direct run; 8-way rows are always exact
+while IFS=, read line sets ways size accesses hits misses rate reads writes amat exact; do
+    case "$sets" in 1|16|256) ;; *) continue ;; esac
+    [ "$ways" = 8 ] && [ "$exact" != 1 ] && ok=0
+    [ "$exact" = 1 ] || continue
+    cat > trace.config << EOF
+Number of sets: $sets
+Set size: $ways
+Line size: $line
+EOF
+    ./cache_simulator -q < test20_trace.txt | awk -v h=$hits -v r=$reads -v w=$writes '
+        /^Hits:/ { a = $2 } /^Memory reads:/ { b = $3 } /^Memory writes:/ { c = $3 }
+        END { exit !(a == h && b == r && c == w) }' || ok=0
+done < test20_mrc.csv
+# The recommendation is the smallest row within the target, fewer ways on ties
+best=$(awk -F, 'NR > 1 && $8 <= 0.40 && (best == "" || $4 < size || ($4 == size && $3 < ways)) {
+                    best = $2 " " $3 " " $1 " " $12; size = $4; ways = $3 }
+                END { print best }' test20_mrc.csv)
+echo "Expected: Exact rows match direct runs, some rows are inexact, and the"
+echo "          recommendation is the smallest row with a miss rate <= 40%"
+echo "  smallest row: $best (sets ways line exact)"
+sed -n '/^Number of sets/,/^Line size/p;/^Note/p' test20_output.txt
+check_result $(awk -v ok=$ok -v best="$best" -F, '
+    FNR == NR { if (NR > 1 && $12 == 0) inexact++; next }
+    /^Number of sets:/ { split($0, f, " +"); s = f[4] } /^Set associativity:/ { split($0, f, " +"); w = f[3] }
+    /^Line size:/ { split($0, f, " +"); l = f[3] } /^Note: approximate/ { note = 1 }
+    END { split(best, b, " "); print (ok && inexact > 0 && s == b[1] && w == b[2] && l == b[3] &&
+                                      note == (b[4] == 0)) }' test20_mrc.csv test20_output.txt)
+rm -f test20_trace.txt
+echo ""
+
+# Test 21: StatStack and StatCache
+echo "Test 21: StatStack and StatCache"
+echo "================================"
+awk 'BEGIN { x = 17; for (i = 0; i < 40000; i++) { x = (x * 1103515245 + 12345) % 2147483648;
+             y = int(x / 65536); z = (y % 4 == 0) ? y % 16384 : (y % 4 == 1) ? y % 1024 : y % 128;
+             printf "%s:4:%08x\n", (y % 7 == 0) ? "W" : "R", z * 32 } }' > test21_trace.txt
+cat > trace.config << EOF
+Number of sets: 64
+Set size: 4
+Line size: 32
+EOF
+
+./cache_simulator --reuse-distance < test21_trace.txt > test21_exact.txt 2>&1
+./cache_simulator --statstack 0.05 --statstack-eval < test21_trace.txt > test21_output.txt 2>&1
+echo "Expected: Mean absolute errors below 2% (LRU) and 3% (random), and the"
+echo "          simulated LRU column equals the exact reuse-distance profile"
+grep "^Mean absolute error" test21_output.txt
+check_result $(awk '/^[0-9]/ && NF == 4 { exact[$3] = 100 - $4; next }
+                    /^Mean absolute error:/ { lru = $5 + 0; rnd = $7 + 0 }
+                    /^[0-9]/ && NF == 6 && ($1 in exact) { n++; d = $5 - exact[$1]
+                                                           if (d > 0.011 || d < -0.011) bad = 1 }
+                    END { print (n >= 10 && !bad && lru < 2 && rnd < 3) }' \
+                    test21_exact.txt test21_output.txt)
+rm -f test21_trace.txt test21_exact.txt
+echo ""
+
+# Test 22: SIMD Lane Engine
+echo "Test 22: SIMD Lane Engine"
+echo "========================="
+cat > test22_configs.txt << EOF
+16 1 16
+64 2 32
+8 2 8
+EOF
+
+./cache_simulator --configs test22_configs.txt --simd validate < test14_long.txt \
+    > test22_output.txt 2>&1
+validated=$?
+./cache_simulator --configs test22_configs.txt --simd scalar < test14_long.txt \
+    > test22_scalar.txt 2>&1
+ok=1
+[ $validated -eq 0 ] && grep -q "validated" test22_output.txt || ok=0
+while read sets ways line; do
+    printf "Number of sets: %d\nSet size: %d\nLine size: %d\n" $sets $ways $line > trace.config
+    hits=$(./cache_simulator -q < test14_long.txt | awk '/^Hits:/ { print $2 }')
+    for f in test22_output.txt test22_scalar.txt; do
+        awk -v s=$sets -v w=$ways -v l=$line -v h=$hits \
+            '$1 == s && $2 == w && $3 == l && $6 == h { found = 1 } END { exit !found }' \
+            $f || ok=0
+    done
+done < test22_configs.txt
+echo "Expected: validate passes; SIMD and scalar hits equal single-config runs"
+grep "SIMD lane engine" test22_output.txt
+check_result $ok
+echo ""
+
+# Test 23: Chunk-Parallel Simulation
+echo "Test 23: Chunk-Parallel Simulation"
+echo "=================================="
+# Three 262144-record chunks; the second and third must be reconciled
+awk 'BEGIN { x = 7; for (i = 0; i < 600000; i++) { x = (x * 1103515245 + 12345) % 2147483648;
+             y = int(x / 65536); printf "%s:4:%08x\n", (y % 5 == 0) ? "W" : "R", (y % 8192) * 8 } }' \
+    > test23_trace.txt
+cat > trace.config << EOF
+Number of sets: 16
+Set size: 2
+Line size: 16
+EOF
+
+./cache_simulator < test23_trace.txt > test23_sequential.txt 2>/dev/null
+./cache_simulator --time-chunks 4 < test23_trace.txt > test23_output.txt 2>/dev/null
+echo "Expected: Per-access lines and summary equal the sequential run"
+tail -3 test23_output.txt
+check_result $(cmp -s test23_output.txt test23_sequential.txt && echo 1)
+rm -f test23_trace.txt test23_sequential.txt
+echo ""
+
+# Test 24: Batch Mode
+echo "Test 24: Batch Mode"
+echo "==================="
+for n in 1 2 3; do
+    awk -v seed=$n 'BEGIN { x = seed; for (i = 0; i < 2000 * seed; i++) {
+                     x = (x * 1103515245 + 12345) % 2147483648; y = int(x / 65536)
+                     printf "%s:4:%08x\n", (y % 4 == 0) ? "W" : "R", (y % (512 * seed)) * 8 } }' \
+        > test24_trace$n.txt
+done
+printf "test24_trace1.txt\ntest24_missing.txt\ntest24_trace2.txt\ntest24_trace3.txt\n" \
+    > test24_manifest.txt
+cat > trace.config << EOF
+Number of sets: 16
+Set size: 2
+Line size: 16
+EOF
+
+# One worker runs every trace on the same cache, so each must start cold
+./cache_simulator --batch test24_manifest.txt --workers 1 > test24_output.txt 2>/dev/null
+ok=1
+for n in 1 2 3; do
+    ./cache_simulator -q < test24_trace$n.txt | awk -v t=test24_trace$n.txt '
+        FNR == NR { if (/^Total accesses:/) a = $3; if (/^Hits:/) h = $2
+                    if (/^Memory reads:/) r = $3; if (/^Memory writes:/) w = $3; next }
+        { split($0, f, ",") }
+        f[1] == t { found = (f[2] == "ok" && f[3] == a && f[4] == h && f[7] == r && f[8] == w) }
+        END { exit !found }' - test24_output.txt || ok=0
+done
+echo "Expected: Rows in manifest order equal single runs; the missing trace is unreadable"
+cat test24_output.txt
+check_result $(awk -F, -v ok=$ok 'NR > 1 { order = order $1 " " } $1 == "test24_missing.txt" { s = $2 }
+                    END { print (ok && s == "unreadable" &&
+                                 order == "test24_trace1.txt test24_missing.txt test24_trace2.txt test24_trace3.txt ") }' \
+                    test24_output.txt)
+echo ""
+
+# Test 25: Sharded Sweep and Merge
+echo "Test 25: Sharded Sweep and Merge"
+echo "================================"
+printf "test14_long.txt\ntest14_short.txt\ntest14_mid.txt\n" > test25_traces.txt
+cat > test25_configs.txt << EOF
+16 2 16
+64 4 32
+8 1 8
+EOF
+
+./cache_simulator --configs test25_configs.txt --sweep test25_traces.txt \
+    > test25_full.csv 2>/dev/null
+for i in 0 1 2 3; do
+    ./cache_simulator --configs test25_configs.txt --sweep test25_traces.txt \
+        --shard $i/4 > test25_part$i.csv 2>/dev/null
+done
+./cache_simulator merge test25_part3.csv test25_part1.csv test25_part0.csv \
+    test25_part2.csv > test25_output.txt 2>&1
+echo "Expected: Merged shards equal the unsharded sweep"
+check_result $(cmp -s test25_output.txt test25_full.csv && echo 1)
+
+# Shards of a different trace list, of a different shard count, or of 0 shards
+printf "test14_mid.txt\ntest14_short.txt\ntest14_long.txt\n" > test25_other.txt
+./cache_simulator --configs test25_configs.txt --sweep test25_other.txt \
+    --shard 1/4 > test25_other1.csv 2>/dev/null
+./cache_simulator --configs test25_configs.txt --sweep test25_traces.txt \
+    --shard 1/2 > test25_half1.csv 2>/dev/null
+sed 's|shard 0/4|shard 0/0|' test25_part0.csv > test25_zero.csv
+rejected=0
+for f in test25_other1.csv test25_half1.csv; do
+    ./cache_simulator merge test25_part0.csv $f test25_part2.csv test25_part3.csv \
+        >> test25_output.txt 2>&1 || rejected=$((rejected + 1))
+done
+./cache_simulator merge test25_zero.csv >> test25_output.txt 2>&1 || rejected=$((rejected + 1))
+echo "Expected: Mismatched job lists, shard counts and 0 shards are rejected"
+grep "^Error" test25_output.txt
+check_result $([ $rejected -eq 3 ] && echo 1)
+rm -f test25_part*.csv test25_other1.csv test25_half1.csv test25_zero.csv
+echo ""
+
+# Test 26: NUMA-Aware Placement
+echo "Test 26: NUMA-Aware Placement"
+echo "============================="
+# Uses the traces and manifest of Test 24
+printf "test24_trace1.txt\ntest24_trace2.txt\ntest24_trace3.txt\n" > test26_traces.txt
+printf "16 2 16\n64 4 32\n" > test26_configs.txt
+cat > trace.config << EOF
+Number of sets: 16
+Set size: 2
+Line size: 16
+EOF
+
+ok=1
+for mode in "--configs test26_configs.txt --sweep test26_traces.txt --workers 3" \
+            "--batch test24_manifest.txt --workers 3" \
+            "-q --set-shards 2" "-q --time-chunks 2"; do
+    ./cache_simulator $mode < test24_trace3.txt > test26_plain.txt 2>/dev/null
+    ./cache_simulator $mode --numa < test24_trace3.txt > test26_output.txt 2>/dev/null
+    [ -s test26_plain.txt ] && cmp -s test26_plain.txt test26_output.txt || ok=0
+done
+echo "Expected: --sweep, --batch, --set-shards and --time-chunks print the same"
+echo "          results with --numa"
+check_result $ok
+rm -f test26_plain.txt
+echo ""
+
+# Test 27: Result Cache Invalidation
+echo "Test 27: Result Cache Invalidation"
+echo "=================================="
+rm -rf test27_cache
+echo "test27_trace.txt" > test27_traces.txt
+echo "64 4 32" > test27_configs.txt
+printf "R:4:00000000\nR:4:00000000\n" > test27_trace.txt
+./cache_simulator --configs test27_configs.txt --sweep test27_traces.txt \
+    --result-cache test27_cache > test27_output.txt 2>/dev/null
+# Same size, normally within the same second
+printf "R:4:00000000\nR:4:00000100\n" > test27_trace.txt
+./cache_simulator --configs test27_configs.txt --sweep test27_traces.txt \
+    --result-cache test27_cache >> test27_output.txt 2>/dev/null
+echo "Expected: The rewritten trace is simulated again (1 hit, then 0 hits)"
+grep "^test27_trace" test27_output.txt
+check_result $(awk -F, '/^test27_trace/ { h[++n] = $6 } END { print (h[1] == 1 && h[2] == 0) }' \
+    test27_output.txt)
+# A FIFO can be read only once, so an uncached trace must be hashed as it is decoded
+rm -f test27_fifo
+mkfifo test27_fifo
+echo "test27_fifo" > test27_traces.txt
+cat test27_trace.txt > test27_fifo &
+timeout 10 ./cache_simulator --configs test27_configs.txt --sweep test27_traces.txt \
+    --result-cache test27_cache >> test27_output.txt 2>/dev/null
+echo "Expected: A trace in a FIFO is read once and fully simulated (2 misses)"
+grep "^test27_fifo" test27_output.txt
+check_result $(awk -F, '/^test27_fifo/ { m = $7 } END { print (m == 2) }' test27_output.txt)
+wait
+rm -rf test27_cache test27_fifo
+echo ""
+
+# Test 28: Checkpoint and Restore
+echo "Test 28: Checkpoint and Restore"
+echo "==============================="
+cat > trace.config << EOF
+Number of sets: 16
+Set size: 2
+Line size: 16
+EOF
+
+./cache_simulator < test14_long.txt > test28_full.txt 2>&1
+./cache_simulator -q --checkpoint 1000:test28.ckpt < test14_long.txt > /dev/null 2>&1
+./cache_simulator --restore test28.ckpt < test14_long.txt > test28_output.txt 2>&1
+cat test14_long.txt | ./cache_simulator --restore test28.ckpt > test28_piped.txt 2>&1
+echo "Expected: Restored run equals the full run minus its first 1000 accesses,"
+echo "          from a seekable file and from a pipe"
+sed -n '/Hits:/p' test28_output.txt
+# Lines 10-1009 of the full run are its first 1000 per-access lines
+check_result $(sed '10,1009d' test28_full.txt | cmp -s - test28_output.txt &&
+               cmp -s test28_output.txt test28_piped.txt && echo 1)
+rm -f test28.ckpt test28_piped.txt
+echo ""
+
+# Test 29: Warmup and Regions of Interest
+echo "Test 29: Warmup and Regions of Interest"
+echo "======================================="
+cat > test29_trace.txt << EOF
+R:4:00000000
+R:4:00000000
+M:start:a
+R:4:00000100
+R:4:00000100
+M:stop
+R:4:00000200
+M:start
+W:4:00000200
+R:4:00000300
+M:stop
+EOF
+
+cat > trace.config << EOF
+Number of sets: 16
+Set size: 2
+Line size: 16
+EOF
+
+./cache_simulator -q --warmup 2 < test29_trace.txt > test29_output.txt 2>&1
+./cache_simulator -q --warmup-lines 2 < test29_trace.txt > test29_lines.txt 2>&1
+echo "Expected: --warmup 2 counts 5 accesses (2 hits); regions a and roi1 each"
+echo "          have 2 accesses and 1 hit; --warmup-lines 2 excludes 3 accesses"
+sed -n '/^Total accesses/p;/^Hits/p;/^Warmup/p;/^a /p;/^roi1 /p' test29_output.txt
+check_result $(awk '/^Total accesses/ { t = $3 } /^Hits:/ { h = $2 } /^Warmup/ { w = $3 }
+                    /^a / { a = $2 "/" $3 } /^roi1 / { r = $2 "/" $3 "/" $7 }
+                    END { print (t == 5 && h == 2 && w == 2 && a == "2/1" && r == "2/1/1") }' \
+                    test29_output.txt)
+check_result $(awk '/^Total accesses/ { t = $3 } /^Hits:/ { h = $2 } /^Warmup/ { w = $3 }
+                    END { print (t == 4 && h == 2 && w == 3) }' test29_lines.txt)
+rm -f test29_lines.txt
+echo ""
+
+# Test 30: Checkpoints During Warmup and Regions
+echo "Test 30: Checkpoints During Warmup and Regions"
+echo "=============================================="
+awk 'BEGIN { x = 3; for (i = 0; i < 400; i++) { x = (x * 1103515245 + 12345) % 2147483648;
+             y = int(x / 65536); if (i == 120) print "M:start:a"; if (i == 300) print "M:stop";
+             printf "%s:4:%08x\n", (y % 4 == 0) ? "W" : "R", (y % 64) * 16 } }' \
+    > test30_trace.txt
+cat > trace.config << EOF
+Number of sets: 16
+Set size: 2
+Line size: 16
+EOF
+
+./cache_simulator -q --warmup 100 < test30_trace.txt > test30_full.txt 2>&1
+ok=1
+# During warmup, inside the open region, and after it
+for at in 50 150 350; do
+    ./cache_simulator -q --warmup 100 --checkpoint $at:test30.ckpt < test30_trace.txt \
+        > /dev/null 2>&1
+    ./cache_simulator -q --restore test30.ckpt < test30_trace.txt > test30_output.txt 2>&1
+    cmp -s test30_output.txt test30_full.txt || ok=0
+done
+./cache_simulator -q --warmup-lines 40 < test30_trace.txt > test30_full.txt 2>&1
+./cache_simulator -q --warmup-lines 40 --checkpoint 10:test30.ckpt < test30_trace.txt \
+    > /dev/null 2>&1
+./cache_simulator -q --restore test30.ckpt < test30_trace.txt > test30_output.txt 2>&1
+cmp -s test30_output.txt test30_full.txt || ok=0
+echo "Expected: Restored runs report the full run's warmup and region counts"
+sed -n '/^Warmup/p;/^a /p' test30_output.txt
+check_result $ok
+rm -f test30.ckpt test30_full.txt
+echo ""
+
+# Test 31: Set Sampling
+echo "Test 31: Set Sampling"
+echo "====================="
+awk 'BEGIN { x = 11; for (i = 0; i < 40000; i++) { x = (x * 1103515245 + 12345) % 2147483648;
+             y = int(x / 65536); printf "%s:4:%08x\n", (y % 4 == 0) ? "W" : "R", (y % 1024) * 32 } }' \
+    > test31_trace.txt
+cat > trace.config << EOF
+Number of sets: 64
+Set size: 4
+Line size: 32
+EOF
+
+./cache_simulator -q < test31_trace.txt > test31_full.txt 2>&1
+./cache_simulator --set-sample 4 < test31_trace.txt > test31_output.txt 2>&1
+./cache_simulator --set-sample 128 < test31_trace.txt > /dev/null 2>&1
+rejected=$?
+echo "Expected: The 95% CIs hold the full run's miss rate and misses, scaled hits"
+echo "          and misses add up to every access, and 1 in 128 of 64 sets is rejected"
+grep -E "^(Total accesses|Miss rate|Misses|Memory writes):" test31_output.txt
+check_result $(awk -v rejected=$rejected '
+    FNR == NR { if (/^Misses:/) m = $2; if (/^Miss rate:/) r = $3; if (/^Memory writes:/) w = $3; next }
+    /^Total accesses:/ { total = $3 }
+    /^Hits:/ { hits = $2 }
+    /^Misses:/ { misses = $2; mok = (misses - $4 <= m && m <= misses + $4) }
+    /^Miss rate:/ { rok = ($3 - $5 <= r && r <= $3 + $5) }
+    /^Memory writes:/ { wok = ($3 == w) }
+    END { print (mok && rok && wok && hits + misses == total && rejected != 0) }' \
+    test31_full.txt test31_output.txt)
+rm -f test31_trace.txt test31_full.txt
+echo ""
+
 echo "========================================="
 echo "All tests completed!"
 echo "========================================="
@@ -129,3 +908,31 @@ echo "  test2_output.txt - LRU verification"
 echo "  test3_output.txt - Write policy"
 echo "  test4_output.txt - Conflict misses"
 echo "  test5_output.txt - Spatial locality"
+echo "  test6_output.txt - Way partitioning"
+echo "  test7_output.txt - High thread ids"
+echo "  test8_output.txt - Interleaved trace sources"
+echo "  test9_output.txt - High thread ids with --threads"
+echo "  test10_output.txt - False sharing attribution"
+echo "  test11_output.txt - Sparse directory"
+echo "  test12_output.txt - Interconnect link scheduling"
+echo "  test13_output.txt - Multi-configuration sweep"
+echo "  test14_output.txt - Pooled sweep ordering"
+echo "  test15_output.txt - Set-sharded simulation"
+echo "  test16_output.txt - Stack-distance exactness"
+echo "  test17_output.txt - All-sets with writes"
+echo "  test18_output.txt - Reuse distance"
+echo "  test19_output.txt - SHARDS sampling"
+echo "  test20_output.txt - Miss-ratio curves and sizing"
+echo "  test21_output.txt - StatStack and StatCache"
+echo "  test22_output.txt - SIMD lane engine"
+echo "  test23_output.txt - Chunk-parallel simulation"
+echo "  test24_output.txt - Batch mode"
+echo "  test25_output.txt - Sharded sweep and merge"
+echo "  test26_output.txt - NUMA-aware placement"
+echo "  test27_output.txt - Result cache invalidation"
+echo "  test28_output.txt - Checkpoint and restore"
+echo "  test29_output.txt - Warmup and regions of interest"
+echo "  test30_output.txt - Checkpoints during warmup and regions"
+echo "  test31_output.txt - Set sampling"
+
+exit $((failures > 0))